@@ -0,0 +1,411 @@
+/********************************************************
+* metrics_load_test.c
+*
+* Scrape load test for the clock metrics endpoint
+*
+* Without -a a local endpoint is run in a server thread:
+* a single threaded poll() loop in place of the lwIP raw
+* TCP callbacks, serving responses from the same metrics.c
+* response cache as metrics_server.c. Each response is in
+* flight until fully sent, so the two buffer handling is
+* exercised by concurrent scrapes. Metrics are changed
+* every -u ms, as the LCD frame time is on the clock.
+*
+* Client threads scrape as fast as possible for -d
+* seconds and report scrapes per second and latency.
+* The local server is run with render on change and with
+* a metrics change before every scrape for comparison.
+*
+* With -a <addr> a clock on the network is scraped.
+*
+* Build:
+*   gcc -O2 -I.. -o metrics_load_test metrics_load_test.c ../metrics.c -lpthread
+*********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "metrics.h"
+
+#define MAX_CLIENTS      64
+#define MAX_CONNECTIONS  128
+#define MAX_LATENCIES    (1024 * 1024)
+
+typedef struct
+{
+    int fd;
+    int sent;
+    metrics_response_t *response;   // NULL until request received
+} server_conn_t;
+
+typedef struct
+{
+    int id;
+    unsigned long scrapes;
+    unsigned long errors;
+    unsigned long bytes;
+    double *latency_us;
+    unsigned long latencies;
+} client_t;
+
+static struct sockaddr_in server_addr;
+static int duration_s = 5;
+static int num_clients = 4;
+static int update_ms = 1000;
+static volatile bool running = true;
+
+// local server state
+static volatile bool server_stop = false;
+static bool render_always = false;     // metrics change before every scrape
+static clock_metrics_t metrics;
+static uint32_t metrics_generation = 1;
+static metrics_response_cache_t response_cache;
+static unsigned long served = 0;
+
+/********************************************************
+* monotonic_us()
+*********************************************************/
+static double monotonic_us( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/********************************************************
+* compare_double()
+*********************************************************/
+static int compare_double( const void *a, const void *b )
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return ( da > db ) - ( da < db );
+}
+
+/********************************************************
+* server_thread()
+*
+* local metrics endpoint
+*********************************************************/
+static void *server_thread( void *arg )
+{
+    static server_conn_t conns[MAX_CONNECTIONS];
+    struct pollfd pfds[MAX_CONNECTIONS + 1];
+    int listen_fd = *(int *)arg;
+    int num_conns = 0;
+    double next_update = monotonic_us() + update_ms * 1000.0;
+    int i;
+
+    while ( !server_stop )
+    {
+        double now = monotonic_us();
+
+        // metrics change as the clock's LCD frame time does
+        if ( update_ms && ( now >= next_update ) )
+        {
+            metrics.lcd_frame_us_last = 100000 + ( metrics_generation % 50 ) * 100;
+            metrics_generation++;
+            next_update = now + update_ms * 1000.0;
+        }
+
+        pfds[0].fd = listen_fd;
+        pfds[0].events = num_conns < MAX_CONNECTIONS ? POLLIN : 0;
+        for ( i = 0; i < num_conns; i++ )
+        {
+            pfds[i+1].fd = conns[i].fd;
+            pfds[i+1].events = conns[i].response ? POLLOUT : POLLIN;
+        }
+
+        if ( poll( pfds, num_conns + 1, 10 ) <= 0 )
+            continue;
+
+        for ( i = num_conns - 1; i >= 0; i-- )
+        {
+            server_conn_t *conn = &conns[i];
+            bool done = false;
+
+            if ( pfds[i+1].revents & ( POLLERR | POLLHUP ) )
+            {
+                done = true;
+            }
+            else if ( !conn->response && ( pfds[i+1].revents & POLLIN ) )
+            {
+                char req[512];
+                if ( recv( conn->fd, req, sizeof(req), 0 ) <= 0 )
+                {
+                    done = true;
+                }
+                else
+                {
+                    if ( render_always )
+                        metrics_generation++;
+                    conn->response = metrics_response_get( &response_cache, &metrics, metrics_generation );
+                    conn->sent = 0;
+                    served++;
+                }
+            }
+
+            if ( !done && conn->response )
+            {
+                metrics_response_t *response = conn->response;
+                ssize_t n = send( conn->fd, response->data + conn->sent, response->len - conn->sent, MSG_NOSIGNAL );
+                if ( n > 0 )
+                    conn->sent += n;
+                if ( ( n < 0 ) && ( errno != EAGAIN ) )
+                    done = true;
+                if ( conn->sent >= response->len )
+                    done = true;
+            }
+
+            if ( done )
+            {
+                metrics_response_release( conn->response );
+                close( conn->fd );
+                conns[i] = conns[--num_conns];
+            }
+        }
+
+        if ( pfds[0].revents & POLLIN )
+        {
+            int fd;
+            while ( ( num_conns < MAX_CONNECTIONS ) && ( ( fd = accept( listen_fd, NULL, NULL ) ) >= 0 ) )
+            {
+                fcntl( fd, F_SETFL, O_NONBLOCK );
+                conns[num_conns].fd = fd;
+                conns[num_conns].sent = 0;
+                conns[num_conns].response = NULL;
+                num_conns++;
+            }
+        }
+    }
+
+    for ( i = 0; i < num_conns; i++ )
+    {
+        metrics_response_release( conns[i].response );
+        close( conns[i].fd );
+    }
+    return NULL;
+}
+
+/********************************************************
+* client_thread()
+*
+* scrape endpoint until running cleared
+*********************************************************/
+static void *client_thread( void *arg )
+{
+    static const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    client_t *client = (client_t *)arg;
+    char buf[2048];
+
+    while ( running )
+    {
+        double start = monotonic_us();
+        unsigned long bytes = 0;
+        ssize_t n;
+        int fd;
+
+        fd = socket( AF_INET, SOCK_STREAM, 0 );
+        if ( ( fd < 0 ) || ( connect( fd, (struct sockaddr *)&server_addr, sizeof(server_addr) ) < 0 ) ||
+             ( send( fd, request, sizeof(request) - 1, MSG_NOSIGNAL ) < 0 ) )
+        {
+            client->errors++;
+            if ( fd >= 0 )
+                close( fd );
+            usleep( 1000 );
+            continue;
+        }
+
+        while ( ( n = recv( fd, buf + ( bytes ? 16 : 0 ), sizeof(buf) - 16, 0 ) ) > 0 )
+            bytes += n;
+        close( fd );
+
+        // first 16 bytes of buf hold the start of the response
+        if ( ( bytes < 12 ) || ( strncmp( buf, "HTTP/1.0 200", 12 ) != 0 ) )
+        {
+            client->errors++;
+            continue;
+        }
+
+        client->scrapes++;
+        client->bytes += bytes;
+        if ( client->latencies < MAX_LATENCIES / MAX_CLIENTS )
+            client->latency_us[client->latencies++] = monotonic_us() - start;
+    }
+    return NULL;
+}
+
+/********************************************************
+* run_clients()
+*
+* print scrapes per second & latency
+*********************************************************/
+static void run_clients( const char *label )
+{
+    static client_t clients[MAX_CLIENTS];
+    pthread_t threads[MAX_CLIENTS];
+    double *all;
+    unsigned long scrapes = 0, errors = 0, bytes = 0, count = 0;
+    double start, elapsed;
+    int i;
+
+    running = true;
+    start = monotonic_us();
+    for ( i = 0; i < num_clients; i++ )
+    {
+        memset( &clients[i], 0, sizeof(clients[i]) );
+        clients[i].id = i;
+        clients[i].latency_us = malloc( sizeof(double) * ( MAX_LATENCIES / MAX_CLIENTS ) );
+        pthread_create( &threads[i], NULL, client_thread, &clients[i] );
+    }
+
+    sleep( duration_s );
+    running = false;
+
+    all = malloc( sizeof(double) * MAX_LATENCIES );
+    for ( i = 0; i < num_clients; i++ )
+    {
+        pthread_join( threads[i], NULL );
+        scrapes += clients[i].scrapes;
+        errors += clients[i].errors;
+        bytes += clients[i].bytes;
+        memcpy( &all[count], clients[i].latency_us, clients[i].latencies * sizeof(double) );
+        count += clients[i].latencies;
+        free( clients[i].latency_us );
+    }
+    elapsed = ( monotonic_us() - start ) / 1e6;
+
+    qsort( all, count, sizeof(double), compare_double );
+
+    printf("%-22s %10.0f %8lu %9.1f %9.1f %9.1f %8.0f\n",
+           label, scrapes / elapsed, errors,
+           count ? all[count / 2] : 0.0, count ? all[( count * 99 ) / 100] : 0.0, count ? all[count - 1] : 0.0,
+           scrapes ? (double)bytes / scrapes : 0.0);
+    free( all );
+}
+
+/********************************************************
+* run_local()
+*
+* start local server thread, run clients against it
+*********************************************************/
+static int run_local( bool always )
+{
+    pthread_t server;
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    char label[64];
+    int listen_fd;
+    int one = 1;
+
+    listen_fd = socket( AF_INET, SOCK_STREAM, 0 );
+    setsockopt( listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one) );
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    if ( ( bind( listen_fd, (struct sockaddr *)&addr, sizeof(addr) ) < 0 ) || ( listen( listen_fd, 128 ) < 0 ) )
+    {
+        perror("bind/listen");
+        close( listen_fd );
+        return -1;
+    }
+    getsockname( listen_fd, (struct sockaddr *)&addr, &addr_len );
+    fcntl( listen_fd, F_SETFL, O_NONBLOCK );
+    server_addr = addr;
+
+    render_always = always;
+    memset( &response_cache, 0, sizeof(response_cache) );
+    served = 0;
+    server_stop = false;
+    pthread_create( &server, NULL, server_thread, &listen_fd );
+
+    snprintf( label, sizeof(label), "local %s", always ? "always changed" : "render on change" );
+    run_clients( label );
+
+    server_stop = true;
+    pthread_join( server, NULL );
+    close( listen_fd );
+
+    printf("%-22s %lu scrapes served, %u renders, %u stale\n", "", served,
+           (unsigned int)response_cache.renders, (unsigned int)response_cache.stale);
+    return 0;
+}
+
+/********************************************************
+* usage()
+*********************************************************/
+static void usage( void )
+{
+    printf("Usage: metrics_load_test [-a addr] [-p port] [-c clients] [-d seconds] [-u update ms]\n");
+}
+
+/********************************************************
+* main()
+*
+* main program body
+*********************************************************/
+int main( int argc, char *argv[] )
+{
+    const char *remote = NULL;
+    int port = 80;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "a:p:c:d:u:h" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'a': remote = optarg; break;
+            case 'p': port = atoi( optarg ); break;
+            case 'c': num_clients = atoi( optarg ); break;
+            case 'd': duration_s = atoi( optarg ); break;
+            case 'u': update_ms = atoi( optarg ); break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if ( ( num_clients < 1 ) || ( num_clients > MAX_CLIENTS ) )
+    {
+        printf("clients must be 1..%d\n", MAX_CLIENTS);
+        return 1;
+    }
+
+    strcpy( metrics.server, "127.0.0.1" );
+    metrics.synced = true;
+    metrics.stratum = 2;
+
+    printf("%d clients, %ds", num_clients, duration_s);
+    if ( !remote )
+        printf(", metrics change every %dms", update_ms);
+    printf("\n\n%-22s %10s %8s %9s %9s %9s %8s\n", "endpoint", "scrapes/s", "errors", "p50 us", "p99 us", "max us", "bytes");
+
+    if ( remote )
+    {
+        memset( &server_addr, 0, sizeof(server_addr) );
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons( port );
+        if ( inet_pton( AF_INET, remote, &server_addr.sin_addr ) != 1 )
+        {
+            printf("invalid address %s\n", remote);
+            return 1;
+        }
+        run_clients( remote );
+    }
+    else
+    {
+        run_local( false );
+        run_local( true );
+    }
+    return 0;
+}
@@ -0,0 +1,292 @@
+/********************************************************
+* ntp_standin.c
+*
+* Local stand-in NTP server
+*
+* Replies to NTP client requests on a UDP port with a
+* configurable clock offset, network delay & jitter and
+* a configurable share of lost, wrong mode, stratum 0,
+* Kiss-o'-Death and truncated replies
+*
+* Network delay is modelled as symmetric: the receive &
+* transmit timestamps are taken half way through the
+* delay and the reply is sent once the full delay has
+* elapsed
+*********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "ntp_packet.h"
+#include "ntp_standin.h"
+
+#define STANDIN_MAX_PENDING 64
+
+static char *fate_names[STANDIN_REPLY_NUM_FATES] = { "good", "lost", "wrong mode", "stratum 0", "kiss-o'-death", "truncated" };
+
+typedef struct
+{
+    struct sockaddr_in client;
+    uint64_t send_at_us;            // monotonic time to send reply
+    int64_t transmit_offset_us;     // transmit timestamp relative to send time
+    uint8_t msg[NTP_MESSAGE_LEN];
+    int len;
+} pending_reply_t;
+
+/********************************************************
+* monotonic_us()
+*********************************************************/
+static uint64_t monotonic_us( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/********************************************************
+* put_be32()
+*********************************************************/
+static void put_be32( uint8_t *buf, uint32_t val )
+{
+    buf[0] = val >> 24;
+    buf[1] = val >> 16;
+    buf[2] = val >> 8;
+    buf[3] = val;
+}
+
+/********************************************************
+* put_ntp_timestamp()
+*
+* host real time + offset_us in NTP timestamp format
+*********************************************************/
+static void put_ntp_timestamp( uint8_t *buf, int64_t offset_us )
+{
+    struct timespec ts;
+    int64_t us;
+
+    clock_gettime( CLOCK_REALTIME, &ts );
+    us = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 + offset_us;
+
+    put_be32( &buf[0], (uint32_t)( us / 1000000 ) + NTP_EPOCH_OFFSET );
+    put_be32( &buf[4], (uint32_t)( ( (uint64_t)( us % 1000000 ) << 32 ) / 1000000 ) );
+}
+
+/********************************************************
+* choose_fate()
+*********************************************************/
+static ntp_standin_fate_t choose_fate( const ntp_standin_config_t *cfg, unsigned int *seed )
+{
+    int roll = rand_r( seed ) % 100;
+    int fate;
+
+    for ( fate = STANDIN_REPLY_LOST; fate < STANDIN_REPLY_NUM_FATES; fate++ )
+    {
+        if ( roll < cfg->pct[fate] )
+            return (ntp_standin_fate_t)fate;
+        roll -= cfg->pct[fate];
+    }
+    return STANDIN_REPLY_GOOD;
+}
+
+/********************************************************
+* build_reply()
+*
+* build server reply for fate, returns reply length
+*********************************************************/
+static int build_reply( const ntp_standin_config_t *cfg, ntp_standin_fate_t fate, const uint8_t *req, int64_t receive_offset_us, uint8_t *msg, unsigned int *seed )
+{
+    uint8_t mode = NTP_MODE_SERVER;
+    uint8_t leap = 0;
+    uint8_t stratum = cfg->stratum;
+    int len = NTP_MESSAGE_LEN;
+
+    memset( msg, 0, NTP_MESSAGE_LEN );
+
+    switch ( fate )
+    {
+        case STANDIN_REPLY_WRONG_MODE:
+            mode = NTP_MODE_CLIENT;
+            break;
+        case STANDIN_REPLY_STRATUM0:
+            stratum = 0;
+            break;
+        case STANDIN_REPLY_KISS_OF_DEATH:
+            leap = NTP_LEAP_UNSYNC;
+            stratum = 0;
+            memcpy( &msg[12], "RATE", 4 );
+            break;
+        case STANDIN_REPLY_TRUNCATED:
+            len = 24 + rand_r( seed ) % 24;
+            break;
+        default:
+            break;
+    }
+
+    msg[0] = leap << 6 | 4 << 3 | mode;
+    msg[1] = stratum;
+    msg[2] = 6;            // poll interval 64s
+    msg[3] = 0xEC;         // precision ~ 2^-20s
+    if ( stratum != 0 )
+        memcpy( &msg[12], "LOCL", 4 );
+
+    // origin timestamp = client transmit timestamp
+    memcpy( &msg[24], &req[40], 8 );
+    // reference timestamp, receive timestamp
+    put_ntp_timestamp( &msg[16], cfg->offset_ms * 1000LL - 1000000 );
+    put_ntp_timestamp( &msg[32], cfg->offset_ms * 1000LL + receive_offset_us );
+    // transmit timestamp filled in when sent
+
+    return len;
+}
+
+/********************************************************
+* ntp_standin_default_config()
+*********************************************************/
+void ntp_standin_default_config( ntp_standin_config_t *cfg )
+{
+    memset( cfg, 0, sizeof(*cfg) );
+    cfg->bind_addr = "127.0.0.1";
+    cfg->port = 12300;
+    cfg->stratum = 2;
+    cfg->seed = 1;
+}
+
+/********************************************************
+* ntp_standin_run()
+*
+* serve NTP requests until *stop is set
+*
+* returns 0 on stop, -1 on socket error
+*********************************************************/
+int ntp_standin_run( const ntp_standin_config_t *cfg, volatile sig_atomic_t *stop )
+{
+    static pending_reply_t pending[STANDIN_MAX_PENDING];
+    unsigned long fate_count[STANDIN_REPLY_NUM_FATES] = { 0 };
+    unsigned long requests = 0;
+    unsigned int seed = cfg->seed;
+    int num_pending = 0;
+    struct sockaddr_in addr;
+    struct pollfd pfd;
+    int sock;
+    int i;
+
+    sock = socket( AF_INET, SOCK_DGRAM, 0 );
+    if ( sock < 0 )
+    {
+        perror("socket");
+        return -1;
+    }
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons( cfg->port );
+    if ( inet_pton( AF_INET, cfg->bind_addr, &addr.sin_addr ) != 1 )
+    {
+        printf("%s: invalid bind address %s\n", __FUNCTION__, cfg->bind_addr);
+        close( sock );
+        return -1;
+    }
+    if ( bind( sock, (struct sockaddr *)&addr, sizeof(addr) ) < 0 )
+    {
+        perror("bind");
+        close( sock );
+        return -1;
+    }
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+
+    while ( !*stop )
+    {
+        uint64_t now = monotonic_us();
+        int timeout_ms = 100;
+
+        /* send replies which are due, find next due time */
+        for ( i = 0; i < num_pending; )
+        {
+            if ( pending[i].send_at_us <= now )
+            {
+                put_ntp_timestamp( &pending[i].msg[40], cfg->offset_ms * 1000LL + pending[i].transmit_offset_us );
+                sendto( sock, pending[i].msg, pending[i].len, 0, (struct sockaddr *)&pending[i].client, sizeof(pending[i].client) );
+                pending[i] = pending[--num_pending];
+            }
+            else
+            {
+                int due_ms = (int)( ( pending[i].send_at_us - now + 999 ) / 1000 );
+                if ( due_ms < timeout_ms )
+                    timeout_ms = due_ms;
+                i++;
+            }
+        }
+
+        if ( poll( &pfd, 1, timeout_ms ) < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            perror("poll");
+            break;
+        }
+
+        if ( pfd.revents & POLLIN )
+        {
+            uint8_t req[NTP_MESSAGE_LEN];
+            struct sockaddr_in client;
+            socklen_t client_len = sizeof(client);
+            ntp_standin_fate_t fate;
+            uint64_t delay_us;
+            ssize_t len;
+
+            len = recvfrom( sock, req, sizeof(req), 0, (struct sockaddr *)&client, &client_len );
+            if ( ( len != NTP_MESSAGE_LEN ) || ( ( req[0] & 0x7 ) != NTP_MODE_CLIENT ) )
+                continue;
+
+            requests++;
+            fate = choose_fate( cfg, &seed );
+            fate_count[fate]++;
+            if ( cfg->verbose )
+                printf("standin:%u request %lu -> %s\n", cfg->port, requests, fate_names[fate]);
+
+            if ( ( fate == STANDIN_REPLY_LOST ) || ( num_pending == STANDIN_MAX_PENDING ) )
+                continue;
+
+            delay_us = cfg->delay_ms * 1000ULL;
+            if ( cfg->jitter_ms )
+                delay_us += ( rand_r( &seed ) % ( cfg->jitter_ms * 1000 ) );
+
+            pending[num_pending].client = client;
+            pending[num_pending].send_at_us = monotonic_us() + delay_us;
+            pending[num_pending].transmit_offset_us = -(int64_t)delay_us / 2;
+            pending[num_pending].len = build_reply( cfg, fate, req, (int64_t)delay_us / 2, pending[num_pending].msg, &seed );
+            num_pending++;
+        }
+    }
+
+    if ( cfg->verbose )
+    {
+        printf("standin:%u %lu requests:", cfg->port, requests);
+        for ( i = 0; i < STANDIN_REPLY_NUM_FATES; i++ )
+            printf(" %s=%lu", fate_names[i], fate_count[i]);
+        printf("\n");
+    }
+
+    close( sock );
+    return 0;
+}
+
+/********************************************************
+* ntp_standin_fate_str()
+*********************************************************/
+const char *ntp_standin_fate_str( ntp_standin_fate_t fate )
+{
+    if ( fate >= STANDIN_REPLY_NUM_FATES )
+        return "unknown";
+    return fate_names[fate];
+}
@@ -0,0 +1,44 @@
+/*******************************************************************
+*
+* ntp_standin.h
+*
+* Local stand-in NTP server for host testing of the clock's
+* NTP client code without Wi-Fi or a public NTP pool
+*
+********************************************************************/
+#ifndef __NTP_STANDIN_H__
+#define __NTP_STANDIN_H__
+
+#include <stdint.h>
+#include <signal.h>
+
+// Fate of each request, chosen at random using the configured percentages
+typedef enum
+{
+    STANDIN_REPLY_GOOD = 0,
+    STANDIN_REPLY_LOST,
+    STANDIN_REPLY_WRONG_MODE,
+    STANDIN_REPLY_STRATUM0,
+    STANDIN_REPLY_KISS_OF_DEATH,
+    STANDIN_REPLY_TRUNCATED,
+    STANDIN_REPLY_NUM_FATES
+} ntp_standin_fate_t;
+
+typedef struct
+{
+    const char *bind_addr;      // default 127.0.0.1
+    uint16_t port;
+    int32_t offset_ms;          // server clock offset from host clock
+    uint32_t delay_ms;          // round trip network delay
+    uint32_t jitter_ms;         // random 0..jitter_ms added to delay
+    uint8_t stratum;            // stratum of good replies
+    uint8_t pct[STANDIN_REPLY_NUM_FATES];   // percentage of requests for each bad fate
+    unsigned int seed;
+    int verbose;
+} ntp_standin_config_t;
+
+void ntp_standin_default_config( ntp_standin_config_t *cfg );
+int ntp_standin_run( const ntp_standin_config_t *cfg, volatile sig_atomic_t *stop );
+const char *ntp_standin_fate_str( ntp_standin_fate_t fate );
+
+#endif // __NTP_STANDIN_H__
@@ -0,0 +1,92 @@
+/********************************************************
+* ntp_standin_server.c
+*
+* Command line front end for the local stand-in NTP
+* server (ntp_standin.c)
+*
+* Build:
+*   gcc -O2 -I.. -o ntp_standin_server ntp_standin_server.c ntp_standin.c ../ntp_packet.c
+*********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "ntp_standin.h"
+
+static volatile sig_atomic_t stop = 0;
+
+/********************************************************
+* handle_signal()
+*********************************************************/
+static void handle_signal( int sig )
+{
+    stop = 1;
+}
+
+/********************************************************
+* usage()
+*********************************************************/
+static void usage( void )
+{
+    printf("Usage: ntp_standin_server [options]\n");
+    printf("  -a <addr>    bind address (default 127.0.0.1)\n");
+    printf("  -p <port>    UDP port (default 12300)\n");
+    printf("  -o <ms>      server clock offset\n");
+    printf("  -d <ms>      round trip delay\n");
+    printf("  -j <ms>      random extra delay 0..ms\n");
+    printf("  -S <n>       stratum of good replies (default 2)\n");
+    printf("  -l <pct>     %% of requests lost\n");
+    printf("  -m <pct>     %% of replies with wrong mode\n");
+    printf("  -z <pct>     %% of replies with stratum 0\n");
+    printf("  -k <pct>     %% of Kiss-o'-Death (RATE) replies\n");
+    printf("  -t <pct>     %% of truncated replies\n");
+    printf("  -r <seed>    random seed\n");
+    printf("  -v           log each request\n");
+}
+
+/********************************************************
+* main()
+*
+* main program body
+*********************************************************/
+int main( int argc, char *argv[] )
+{
+    ntp_standin_config_t cfg;
+    int opt;
+
+    ntp_standin_default_config( &cfg );
+
+    while ( ( opt = getopt( argc, argv, "a:p:o:d:j:S:l:m:z:k:t:r:vh" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'a': cfg.bind_addr = optarg; break;
+            case 'p': cfg.port = atoi( optarg ); break;
+            case 'o': cfg.offset_ms = atoi( optarg ); break;
+            case 'd': cfg.delay_ms = atoi( optarg ); break;
+            case 'j': cfg.jitter_ms = atoi( optarg ); break;
+            case 'S': cfg.stratum = atoi( optarg ); break;
+            case 'l': cfg.pct[STANDIN_REPLY_LOST] = atoi( optarg ); break;
+            case 'm': cfg.pct[STANDIN_REPLY_WRONG_MODE] = atoi( optarg ); break;
+            case 'z': cfg.pct[STANDIN_REPLY_STRATUM0] = atoi( optarg ); break;
+            case 'k': cfg.pct[STANDIN_REPLY_KISS_OF_DEATH] = atoi( optarg ); break;
+            case 't': cfg.pct[STANDIN_REPLY_TRUNCATED] = atoi( optarg ); break;
+            case 'r': cfg.seed = atoi( optarg ); break;
+            case 'v': cfg.verbose = 1; break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    signal( SIGINT, handle_signal );
+    signal( SIGTERM, handle_signal );
+
+    printf("stand-in NTP server on %s:%u offset %dms delay %ums jitter %ums\n",
+           cfg.bind_addr, cfg.port, cfg.offset_ms, cfg.delay_ms, cfg.jitter_ms);
+
+    return ntp_standin_run( &cfg, &stop ) ? 1 : 0;
+}
@@ -0,0 +1,675 @@
+/********************************************************
+* ntp_sync_bench.c
+*
+* End-to-end NTP sync latency benchmark
+*
+* Runs the clock's NTP client request/validation code
+* (ntp_packet.c, as used by ntp_receive()) against local
+* stand-in NTP servers (ntp_standin.c) for a set of
+* scenarios and reports time-to-first-sync, final offset
+* error and robustness counts as a results table
+*
+* Retries follow the clock: one request per attempt, an
+* attempt ends on the first datagram received, valid or
+* not, a lost reply costs the clock's race timeout and
+* the next attempt is NTP_UNSYNCED_RETRY_S later. Waits
+* beyond the reply timeout are added to the time to sync
+* rather than slept through
+*
+* Race scenarios run several stand-in servers with
+* different delays and compare syncing from the first
+* server only, the next server on each retry, and racing
+* all of them with the clock's selection code (ntp_race.c)
+* and settings (ntp_race.h). Once no reply has arrived
+* for the reply timeout the rest of the clock's race
+* timeout is added to the time to sync, not waited for
+*
+* Build:
+*   gcc -O2 -I.. -o ntp_sync_bench ntp_sync_bench.c ntp_standin.c ../ntp_packet.c ../ntp_race.c
+*********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "ntp_packet.h"
+#include "ntp_race.h"
+#include "ntp_standin.h"
+
+#define MAX_TRIALS 1000
+
+typedef struct
+{
+    const char *name;
+    int32_t offset_ms;
+    uint32_t delay_ms;
+    uint32_t jitter_ms;
+    uint8_t pct[STANDIN_REPLY_NUM_FATES];
+} scenario_t;
+
+/*                name         offset  delay jitter   good lost mode strat0 kod trunc */
+static const scenario_t scenarios[] =
+{
+    { "ideal",          0,      1,     0,   { 0,    0,   0,    0,    0,   0 } },
+    { "delay50",        0,     50,    10,   { 0,    0,   0,    0,    0,   0 } },
+    { "offset+2500",  2500,     5,     0,   { 0,    0,   0,    0,    0,   0 } },
+    { "loss30",         0,      5,     0,   { 0,   30,   0,    0,    0,   0 } },
+    { "wrongmode30",    0,      5,     0,   { 0,    0,  30,    0,    0,   0 } },
+    { "stratum0-30",    0,      5,     0,   { 0,    0,   0,   30,    0,   0 } },
+    { "kod30",          0,      5,     0,   { 0,    0,   0,    0,   30,   0 } },
+    { "truncated30",    0,      5,     0,   { 0,    0,   0,    0,    0,  30 } },
+    { "mixed",        -750,    20,    20,   { 0,   10,  10,   10,   10,  10 } },
+};
+
+#define NUM_SCENARIOS (sizeof(scenarios)/sizeof(scenarios[0]))
+
+typedef struct
+{
+    const char *name;
+    int num_servers;
+    uint32_t delay_ms[NTP_RACE_MAX_CANDIDATES];
+    uint8_t lost_pct[NTP_RACE_MAX_CANDIDATES];
+} race_scenario_t;
+
+/*                  name          servers   delay ms               lost %   */
+static const race_scenario_t race_scenarios[] =
+{
+    { "race-far1st",     4,     { 120, 60, 25, 8 },    { 0,  0,  0,  0 } },
+    { "race-near1st",    4,     { 8, 25, 60, 120 },    { 0,  0,  0,  0 } },
+    { "race-dead1st",    4,     { 8, 25, 60, 120 },    { 100, 0, 0,  0 } },
+    { "race-loss",       4,     { 120, 60, 25, 8 },    { 20, 30, 30, 50 } },
+    { "race-allfar",     3,     { 150, 90, 200 },      { 0,  0,  0 } },
+};
+
+#define NUM_RACE_SCENARIOS (sizeof(race_scenarios)/sizeof(race_scenarios[0]))
+
+// how a race scenario's servers are used
+typedef enum
+{
+    STRATEGY_FIRST = 0,     // first server only, as with a single NTP server
+    STRATEGY_SEQUENTIAL,    // next server on each retry
+    STRATEGY_RACE,          // all servers at once, ntp_race.c selection
+    STRATEGY_NUM
+} strategy_t;
+
+static const char *strategy_names[STRATEGY_NUM] = { "first", "sequential", "race" };
+
+typedef struct
+{
+    int trials;
+    int synced;
+    double ttfs_ms[MAX_TRIALS];         // time to first sync of synced trials
+    double err_ms[MAX_TRIALS];          // clock error using the reply's whole seconds
+    double err_corr_ms[MAX_TRIALS];     // clock error using fraction + half round trip
+    unsigned long requests;
+    unsigned long timeouts;
+    unsigned long invalid_source;
+    unsigned long results[NTP_RESPONSE_NUM_RESULTS];
+} scenario_result_t;
+
+typedef struct
+{
+    int trials;
+    int synced;
+    double ttfs_ms[MAX_TRIALS];
+    double delay_ms[MAX_TRIALS];        // round trip delay of reply synced from
+    double err_ms[MAX_TRIALS];          // clock error at race end using the reply's whole seconds
+    double err_set_ms[MAX_TRIALS];      // clock error at race end as ntp_sync() sets the RTC
+    double err_corr_ms[MAX_TRIALS];
+    unsigned long requests;
+    unsigned long invalid;
+} race_result_t;
+
+static volatile sig_atomic_t stop = 0;
+
+static int num_trials = 20;
+static int reply_timeout_ms = 500;
+static int max_attempts = 5;
+static uint16_t base_port = 12300;
+
+/********************************************************
+* handle_signal()
+*********************************************************/
+static void handle_signal( int sig )
+{
+    stop = 1;
+}
+
+/********************************************************
+* monotonic_ms()
+*********************************************************/
+static double monotonic_ms( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/********************************************************
+* monotonic_us()
+*********************************************************/
+static uint64_t monotonic_us( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+/********************************************************
+* realtime_ms()
+*********************************************************/
+static double realtime_ms( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_REALTIME, &ts );
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/********************************************************
+* compare_double()
+*********************************************************/
+static int compare_double( const void *a, const void *b )
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return ( da > db ) - ( da < db );
+}
+
+/********************************************************
+* percentile()
+*
+* values must be sorted
+*********************************************************/
+static double percentile( const double *values, int count, int pct )
+{
+    if ( count == 0 )
+        return 0.0;
+    return values[ ( count - 1 ) * pct / 100 ];
+}
+
+/********************************************************
+* mean_abs()
+*********************************************************/
+static double mean_abs( const double *values, int count )
+{
+    double sum = 0.0;
+    int i;
+    if ( count == 0 )
+        return 0.0;
+    for ( i = 0; i < count; i++ )
+        sum += values[i] < 0 ? -values[i] : values[i];
+    return sum / count;
+}
+
+/********************************************************
+* run_trial()
+*
+* one clock sync: send request, wait for first datagram,
+* validate with ntp_parse_response(), retry on failure
+* as the clock does
+*********************************************************/
+static void run_trial( int sock, const struct sockaddr_in *server, const scenario_t *scenario, scenario_result_t *res )
+{
+    double start = monotonic_ms();
+    double skipped_ms = 0.0;
+    int attempt;
+
+    for ( attempt = 0; attempt < max_attempts; attempt++ )
+    {
+        uint8_t req[NTP_MESSAGE_LEN];
+        uint8_t buf[NTP_MESSAGE_LEN * 2];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        ntp_response_t resp;
+        ntp_response_result_t result;
+        double sent, received;
+        ssize_t len;
+
+        if ( attempt > 0 )
+            skipped_ms += NTP_UNSYNCED_RETRY_S * 1000.0;
+
+        ntp_build_request( req );
+        sent = monotonic_ms();
+        sendto( sock, req, sizeof(req), 0, (const struct sockaddr *)server, sizeof(*server) );
+        res->requests++;
+
+        if ( poll( &pfd, 1, reply_timeout_ms ) <= 0 )
+        {
+            // lost, the clock waits out the race timeout
+            res->timeouts++;
+            skipped_ms += NTP_RACE_TIMEOUT_MS - reply_timeout_ms;
+            continue;
+        }
+
+        len = recvfrom( sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len );
+        received = monotonic_ms();
+
+        if ( ( from.sin_addr.s_addr != server->sin_addr.s_addr ) || ( from.sin_port != server->sin_port ) )
+        {
+            res->invalid_source++;
+            continue;
+        }
+
+        result = ntp_parse_response( buf, len < 0 ? 0 : (uint16_t)len, &resp );
+        res->results[result]++;
+
+        if ( result == NTP_RESPONSE_OK )
+        {
+            double true_ms = realtime_ms() + scenario->offset_ms;
+            double clock_ms = ntp_to_unix_seconds( resp.transmit_seconds ) * 1000.0;
+            double frac_ms = resp.transmit_fraction * 1000.0 / 4294967296.0;
+
+            res->ttfs_ms[res->synced] = received - start + skipped_ms;
+            res->err_ms[res->synced] = clock_ms - true_ms;
+            res->err_corr_ms[res->synced] = clock_ms + frac_ms + ( received - sent ) / 2 - true_ms;
+            res->synced++;
+            return;
+        }
+    }
+}
+
+/********************************************************
+* run_scenario()
+*
+* fork a stand-in server for the scenario and run the
+* client trials against it
+*********************************************************/
+static int run_scenario( int index, scenario_result_t *res )
+{
+    const scenario_t *scenario = &scenarios[index];
+    ntp_standin_config_t cfg;
+    struct sockaddr_in server;
+    pid_t pid;
+    int sock;
+    int i;
+
+    ntp_standin_default_config( &cfg );
+    cfg.port = base_port + index;
+    cfg.offset_ms = scenario->offset_ms;
+    cfg.delay_ms = scenario->delay_ms;
+    cfg.jitter_ms = scenario->jitter_ms;
+    cfg.seed = 1 + index;
+    memcpy( cfg.pct, scenario->pct, sizeof(cfg.pct) );
+
+    fflush( stdout );
+    pid = fork();
+    if ( pid < 0 )
+    {
+        perror("fork");
+        return -1;
+    }
+    if ( pid == 0 )
+    {
+        signal( SIGTERM, handle_signal );
+        _exit( ntp_standin_run( &cfg, &stop ) ? 1 : 0 );
+    }
+
+    // allow stand-in server to bind
+    usleep( 50000 );
+
+    memset( res, 0, sizeof(*res) );
+
+    sock = socket( AF_INET, SOCK_DGRAM, 0 );
+    if ( sock >= 0 )
+    {
+        memset( &server, 0, sizeof(server) );
+        server.sin_family = AF_INET;
+        server.sin_port = htons( cfg.port );
+        inet_pton( AF_INET, cfg.bind_addr, &server.sin_addr );
+
+        for ( i = 0; ( i < num_trials ) && !stop; i++ )
+        {
+            run_trial( sock, &server, scenario, res );
+            res->trials++;
+        }
+        close( sock );
+    }
+    else
+    {
+        perror("socket");
+    }
+
+    kill( pid, SIGTERM );
+    waitpid( pid, NULL, 0 );
+
+    return sock >= 0 ? 0 : -1;
+}
+
+/********************************************************
+* print_result()
+*********************************************************/
+static void print_result( const scenario_t *scenario, scenario_result_t *res )
+{
+    qsort( res->ttfs_ms, res->synced, sizeof(double), compare_double );
+
+    printf("%-12s %4d/%-4d %8.2f %8.2f %8.2f %9.1f %9.1f %5lu %5lu %5lu %5lu %5lu %5lu %5lu\n",
+           scenario->name, res->synced, res->trials,
+           percentile( res->ttfs_ms, res->synced, 50 ),
+           percentile( res->ttfs_ms, res->synced, 95 ),
+           percentile( res->ttfs_ms, res->synced, 100 ),
+           mean_abs( res->err_ms, res->synced ),
+           mean_abs( res->err_corr_ms, res->synced ),
+           res->requests, res->timeouts, res->invalid_source,
+           res->results[NTP_RESPONSE_BAD_LENGTH],
+           res->results[NTP_RESPONSE_BAD_MODE],
+           res->results[NTP_RESPONSE_BAD_STRATUM],
+           res->results[NTP_RESPONSE_KISS_OF_DEATH]);
+}
+
+/********************************************************
+* run_race_attempt()
+*
+* send requests to the candidate servers and select the
+* reply with ntp_race.c, fresh socket so late replies to
+* an earlier attempt are not seen
+*
+* end_us is set to the time the race ended, skipped_us
+* to the part of the race timeout not waited for
+*********************************************************/
+static ntp_race_state_t run_race_attempt( const struct sockaddr_in *servers, const int *candidates, int num_candidates,
+                                          ntp_race_t *race, race_result_t *res, uint64_t *end_us, uint64_t *skipped_us )
+{
+    ntp_race_state_t state;
+    uint64_t last_us;
+    int sock;
+    int i;
+
+    *end_us = monotonic_us();
+    *skipped_us = 0;
+
+    sock = socket( AF_INET, SOCK_DGRAM, 0 );
+    if ( sock < 0 )
+    {
+        perror("socket");
+        return NTP_RACE_FAILED;
+    }
+
+    ntp_race_start( race, monotonic_us(), NTP_RACE_GOOD_DELAY_MS * 1000, NTP_RACE_GRACE_MS * 1000, NTP_RACE_TIMEOUT_MS * 1000 );
+    last_us = race->start_us;
+    for ( i = 0; i < num_candidates; i++ )
+    {
+        uint8_t req[NTP_MESSAGE_LEN];
+
+        ntp_build_request( req );
+        ntp_race_add( race, monotonic_us() );
+        sendto( sock, req, sizeof(req), 0, (const struct sockaddr *)&servers[candidates[i]], sizeof(servers[0]) );
+        res->requests++;
+    }
+
+    do
+    {
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+
+        if ( poll( &pfd, 1, 1 ) > 0 )
+        {
+            uint8_t buf[NTP_MESSAGE_LEN * 2];
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ntp_response_result_t result = NTP_RESPONSE_BAD_LENGTH;
+            ssize_t len;
+            int candidate = -1;
+
+            len = recvfrom( sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len );
+            for ( i = 0; i < num_candidates; i++ )
+            {
+                if ( ( from.sin_addr.s_addr == servers[candidates[i]].sin_addr.s_addr ) && ( from.sin_port == servers[candidates[i]].sin_port ) )
+                    candidate = i;
+            }
+            last_us = monotonic_us();
+            ntp_race_response( race, candidate, buf, len < 0 ? 0 : (uint16_t)len, last_us, &result );
+            if ( result != NTP_RESPONSE_OK )
+                res->invalid++;
+        }
+        *end_us = monotonic_us();
+        state = ntp_race_poll( race, *end_us, false );
+
+        if ( ( state == NTP_RACE_RUNNING ) && ( *end_us - last_us >= reply_timeout_ms * 1000ull ) )
+        {
+            // no more replies, the clock waits for the grace period or race timeout
+            uint64_t race_end_us = race->start_us + race->timeout_us;
+
+            if ( ( race->best >= 0 ) && ( race->first_valid_us + race->grace_us < race_end_us ) )
+                race_end_us = race->first_valid_us + race->grace_us;
+            if ( race_end_us > *end_us )
+                *skipped_us = race_end_us - *end_us;
+            state = ntp_race_poll( race, *end_us + *skipped_us, false );
+        }
+    }
+    while ( state == NTP_RACE_RUNNING );
+
+    close( sock );
+    return state;
+}
+
+/********************************************************
+* run_race_trial()
+*
+* one clock sync using strategy, up to max_attempts
+* NTP_UNSYNCED_RETRY_S apart as the clock retries
+*********************************************************/
+static void run_race_trial( const struct sockaddr_in *servers, int num_servers, strategy_t strategy, race_result_t *res )
+{
+    double start = monotonic_ms();
+    double skipped_ms = 0.0;
+    int attempt;
+
+    for ( attempt = 0; attempt < max_attempts; attempt++ )
+    {
+        int candidates[NTP_RACE_MAX_CANDIDATES];
+        int num_candidates = 1;
+        ntp_race_t race;
+        ntp_race_state_t state;
+        uint64_t end_us, skipped_us;
+        int i;
+
+        if ( attempt > 0 )
+            skipped_ms += NTP_UNSYNCED_RETRY_S * 1000.0;
+
+        if ( strategy == STRATEGY_RACE )
+        {
+            for ( i = 0; i < num_servers; i++ )
+                candidates[i] = i;
+            num_candidates = num_servers;
+        }
+        else
+        {
+            candidates[0] = strategy == STRATEGY_SEQUENTIAL ? attempt % num_servers : 0;
+        }
+
+        state = run_race_attempt( servers, candidates, num_candidates, &race, res, &end_us, &skipped_us );
+        skipped_ms += skipped_us / 1000.0;
+
+        if ( state == NTP_RACE_DONE )
+        {
+            // true time when the race ended, correction & rounding as ntp_sync()
+            double true_ms = realtime_ms() - ( monotonic_us() - end_us ) / 1000.0;
+            double seconds_ms = ntp_to_unix_seconds( race.best_resp.transmit_seconds ) * 1000.0;
+            int64_t correction_ms = ( ntp_fraction_to_us( race.best_resp.transmit_fraction ) + race.best_delay_us / 2 +
+                                      (int64_t)( end_us - race.best_response_us ) ) / 1000;
+
+            res->ttfs_ms[res->synced] = monotonic_ms() - start + skipped_ms;
+            res->delay_ms[res->synced] = race.best_delay_us / 1000.0;
+            res->err_ms[res->synced] = seconds_ms - true_ms;
+            res->err_set_ms[res->synced] = seconds_ms + ( correction_ms + 500 ) / 1000 * 1000.0 - true_ms;
+            res->err_corr_ms[res->synced] = seconds_ms + race.best_resp.transmit_fraction * 1000.0 / 4294967296.0 +
+                                            race.best_delay_us / 2000.0 + ( end_us - race.best_response_us ) / 1000.0 - true_ms;
+            res->synced++;
+            return;
+        }
+    }
+}
+
+/********************************************************
+* run_race_scenario()
+*
+* fork a stand-in server for each of the scenario's
+* servers and run the trials for each strategy
+*********************************************************/
+static void run_race_scenario( int index )
+{
+    static race_result_t res;
+    const race_scenario_t *scenario = &race_scenarios[index];
+    struct sockaddr_in servers[NTP_RACE_MAX_CANDIDATES];
+    pid_t pids[NTP_RACE_MAX_CANDIDATES];
+    int strategy;
+    int i;
+
+    for ( i = 0; i < scenario->num_servers; i++ )
+    {
+        ntp_standin_config_t cfg;
+
+        ntp_standin_default_config( &cfg );
+        cfg.port = base_port + NUM_SCENARIOS + index * NTP_RACE_MAX_CANDIDATES + i;
+        cfg.delay_ms = scenario->delay_ms[i];
+        cfg.pct[STANDIN_REPLY_LOST] = scenario->lost_pct[i];
+        cfg.seed = 100 + index * NTP_RACE_MAX_CANDIDATES + i;
+
+        memset( &servers[i], 0, sizeof(servers[i]) );
+        servers[i].sin_family = AF_INET;
+        servers[i].sin_port = htons( cfg.port );
+        inet_pton( AF_INET, cfg.bind_addr, &servers[i].sin_addr );
+
+        fflush( stdout );
+        pids[i] = fork();
+        if ( pids[i] < 0 )
+        {
+            perror("fork");
+            break;
+        }
+        if ( pids[i] == 0 )
+        {
+            signal( SIGTERM, handle_signal );
+            _exit( ntp_standin_run( &cfg, &stop ) ? 1 : 0 );
+        }
+    }
+
+    // allow stand-in servers to bind
+    usleep( 50000 );
+
+    for ( strategy = 0; ( i == scenario->num_servers ) && ( strategy < STRATEGY_NUM ) && !stop; strategy++ )
+    {
+        int trial;
+
+        memset( &res, 0, sizeof(res) );
+        for ( trial = 0; ( trial < num_trials ) && !stop; trial++ )
+        {
+            run_race_trial( servers, scenario->num_servers, strategy, &res );
+            res.trials++;
+        }
+
+        qsort( res.ttfs_ms, res.synced, sizeof(double), compare_double );
+        printf("%-13s %-10s %4d/%-4d %8.2f %8.2f %8.2f %9.2f %9.1f %9.1f %9.1f %5lu %5lu\n",
+               scenario->name, strategy_names[strategy], res.synced, res.trials,
+               percentile( res.ttfs_ms, res.synced, 50 ),
+               percentile( res.ttfs_ms, res.synced, 95 ),
+               percentile( res.ttfs_ms, res.synced, 100 ),
+               mean_abs( res.delay_ms, res.synced ),
+               mean_abs( res.err_ms, res.synced ),
+               mean_abs( res.err_set_ms, res.synced ),
+               mean_abs( res.err_corr_ms, res.synced ),
+               res.requests, res.invalid);
+    }
+
+    while ( i-- > 0 )
+    {
+        kill( pids[i], SIGTERM );
+        waitpid( pids[i], NULL, 0 );
+    }
+}
+
+/********************************************************
+* selected()
+*
+* true if no scenario names given or name is one of them
+*********************************************************/
+static int selected( const char *name, int argc, char *argv[] )
+{
+    int j;
+
+    if ( optind >= argc )
+        return 1;
+    for ( j = optind; j < argc; j++ )
+    {
+        if ( strcmp( argv[j], name ) == 0 )
+            return 1;
+    }
+    return 0;
+}
+
+/********************************************************
+* usage()
+*********************************************************/
+static void usage( void )
+{
+    printf("Usage: ntp_sync_bench [-n trials] [-T reply timeout ms] [-A max attempts] [-p base port] [scenario...]\n");
+    printf("  -T   wait for a reply, the rest of the clock's %dms race timeout is modelled\n", NTP_RACE_TIMEOUT_MS);
+    printf("  -A   attempts before a trial counts as not synced, %ds apart as the clock retries\n", NTP_UNSYNCED_RETRY_S);
+}
+
+/********************************************************
+* main()
+*
+* main program body
+*********************************************************/
+int main( int argc, char *argv[] )
+{
+    static scenario_result_t res;
+    int opt;
+    int i;
+
+    while ( ( opt = getopt( argc, argv, "n:T:A:p:h" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'n': num_trials = atoi( optarg ); break;
+            case 'T': reply_timeout_ms = atoi( optarg ); break;
+            case 'A': max_attempts = atoi( optarg ); break;
+            case 'p': base_port = atoi( optarg ); break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if ( ( num_trials < 1 ) || ( num_trials > MAX_TRIALS ) )
+    {
+        printf("trials must be 1..%d\n", MAX_TRIALS);
+        return 1;
+    }
+
+    signal( SIGINT, handle_signal );
+
+    printf("%d trials, %dms reply timeout, %d attempts\n", num_trials, reply_timeout_ms, max_attempts);
+    printf("clock retry policy modelled: lost reply waits out the %dms race timeout, next attempt %ds later\n\n",
+           NTP_RACE_TIMEOUT_MS, NTP_UNSYNCED_RETRY_S);
+    printf("%-12s %9s %8s %8s %8s %9s %9s %5s %5s %5s %5s %5s %5s %5s\n",
+           "scenario", "synced", "p50 ms", "p95 ms", "max ms", "|err| ms", "|corr| ms",
+           "reqs", "tmo", "src", "len", "mode", "strat", "kod");
+
+    for ( i = 0; ( i < (int)NUM_SCENARIOS ) && !stop; i++ )
+    {
+        if ( selected( scenarios[i].name, argc, argv ) && ( run_scenario( i, &res ) == 0 ) )
+            print_result( &scenarios[i], &res );
+    }
+
+    printf("\nrace: first valid reply <= %dms delay, else lowest delay within %dms of first valid reply, %dms timeout\n",
+           NTP_RACE_GOOD_DELAY_MS, NTP_RACE_GRACE_MS, NTP_RACE_TIMEOUT_MS);
+    printf("error at race end: err whole seconds, set rounded as ntp_sync() sets the RTC, corr fraction + half round trip\n\n");
+    printf("%-13s %-10s %9s %8s %8s %8s %9s %9s %9s %9s %5s %5s\n",
+           "scenario", "strategy", "synced", "p50 ms", "p95 ms", "max ms", "delay ms", "|err| ms", "|set| ms", "|corr| ms", "reqs", "inval");
+
+    for ( i = 0; ( i < (int)NUM_RACE_SCENARIOS ) && !stop; i++ )
+    {
+        if ( selected( race_scenarios[i].name, argc, argv ) )
+            run_race_scenario( i );
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+/********************************************************
+* tlog_bench.c
+*
+* Tokenised logging (tlog.c) vs printf benchmark
+*
+* Runs the host build of tlog.c for the clock's log lines
+* and reports per call cost of tlog(), snprintf() and
+* fprintf() (to /dev/null), and bytes sent per line as
+* tlog frames vs text. TSC cycles are shown on x86.
+*
+* Log lines use the clock's format strings (tlog_fmt.h)
+* and the flash saved is the size of those strings, which
+* tlog() keeps in .tlog_fmt rather than flash; for the
+* firmware "./tlog_decode -s <elf>" reports the same
+*
+* On the clock press 'b' on the UART console for cycles
+* per call of tlog(), snprintf() and printf() to the UART.
+*
+* -o <file> writes sample text and frames which can be
+* decoded with "./tlog_decode tlog_bench <file>"
+*
+* Build (-no-pie so format string addresses match the ELF):
+*   gcc -O2 -no-pie -I.. -o tlog_bench tlog_bench.c ../tlog.c
+*********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "tlog.h"
+#include "tlog_fmt.h"
+
+// records per batch, fits in the ring with 8 arguments
+#define BATCH 40
+
+extern FILE *tlog_host_output;
+
+typedef enum
+{
+    LOG_TLOG = 0,
+    LOG_SNPRINTF,
+    LOG_FPRINTF,
+    LOG_NUM_METHODS
+} log_method_t;
+
+static const char *method_names[LOG_NUM_METHODS] = { "tlog", "snprintf", "fprintf" };
+
+static int iterations = 1000000;
+static FILE *null_fp;
+static char line[128];
+
+/********************************************************
+* monotonic_ns()
+*********************************************************/
+static double monotonic_ns( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/********************************************************
+* cycles()
+*********************************************************/
+static uint64_t cycles( void )
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/********************************************************
+* log_display()
+*
+* display loop log line, 8 arguments
+*********************************************************/
+static void log_display( log_method_t method, int i )
+{
+    switch ( method )
+    {
+        case LOG_TLOG:
+            tlog( TLOG_FMT_DISPLAY, 19, 10, 2026, 12, 34, i % 60, 1, 1 );
+            break;
+        case LOG_SNPRINTF:
+            snprintf( line, sizeof(line), TLOG_FMT_DISPLAY "\n", 19, 10, 2026, 12, 34, i % 60, 1, 1 );
+            break;
+        default:
+            fprintf( null_fp, TLOG_FMT_DISPLAY "\n", 19, 10, 2026, 12, 34, i % 60, 1, 1 );
+            break;
+    }
+}
+
+/********************************************************
+* log_ntp_rx()
+*
+* ntp_sync() log line, 8 arguments
+*********************************************************/
+static void log_ntp_rx( log_method_t method, int i )
+{
+    switch ( method )
+    {
+        case LOG_TLOG:
+            tlog( TLOG_FMT_NTP_SYNC, 2026, 10, 19, 3, 0, i % 60, -12, 23418 );
+            break;
+        case LOG_SNPRINTF:
+            snprintf( line, sizeof(line), TLOG_FMT_NTP_SYNC "\n", 2026, 10, 19, 3, 0, i % 60, -12, 23418 );
+            break;
+        default:
+            fprintf( null_fp, TLOG_FMT_NTP_SYNC "\n", 2026, 10, 19, 3, 0, i % 60, -12, 23418 );
+            break;
+    }
+}
+
+/********************************************************
+* run()
+*
+* time iterations log calls in batches, tlog ring is
+* drained (untimed) between batches
+*********************************************************/
+static void run( const char *name, void (*log_line)( log_method_t, int ) )
+{
+    double ns[LOG_NUM_METHODS];
+    double cyc[LOG_NUM_METHODS];
+    unsigned long text_bytes = 0, frame_bytes = 0;
+    int method;
+
+    for ( method = 0; method < LOG_NUM_METHODS; method++ )
+    {
+        double total_ns = 0.0;
+        uint64_t total_cycles = 0;
+        int i = 0;
+
+        while ( i < iterations )
+        {
+            double start_ns = monotonic_ns();
+            uint64_t start_cycles = cycles();
+            int j;
+
+            for ( j = 0; ( j < BATCH ) && ( i < iterations ); j++, i++ )
+                log_line( method, i );
+
+            total_cycles += cycles() - start_cycles;
+            total_ns += monotonic_ns() - start_ns;
+
+            if ( method == LOG_TLOG )
+                frame_bytes += tlog_drain();
+            else if ( method == LOG_SNPRINTF )
+                text_bytes += strlen( line ) * j;
+        }
+        ns[method] = total_ns / iterations;
+        cyc[method] = (double)total_cycles / iterations;
+    }
+
+    printf("%-10s", name);
+    for ( method = 0; method < LOG_NUM_METHODS; method++ )
+    {
+#ifdef HAVE_TSC
+        printf(" %8.1f %7.0f", ns[method], cyc[method]);
+#else
+        printf(" %8.1f %7s", ns[method], "-");
+#endif
+    }
+    printf(" %7.1f %7.1f\n", (double)frame_bytes / iterations, (double)text_bytes / iterations);
+}
+
+/********************************************************
+* write_sample()
+*
+* text and frames as they appear on the UART console
+*********************************************************/
+static int write_sample( const char *path )
+{
+    int i;
+
+    tlog_host_output = fopen( path, "wb" );
+    if ( !tlog_host_output )
+    {
+        perror( path );
+        return -1;
+    }
+
+    fprintf( tlog_host_output, "\n\n\nNTP Clock: main()\n" );
+    for ( i = 0; i < 5; i++ )
+        log_display( LOG_TLOG, i );
+    tlog_drain();
+    fprintf( tlog_host_output, "metrics server on port 80\n" );
+    tlog( TLOG_FMT_DNS_FOUND, 192u, 168u, 1u, 123u, 0 );
+    tlog( TLOG_FMT_NTP_OK, 0 );
+    tlog( TLOG_FMT_NTP_REJECTED, 1, 4 );
+    log_ntp_rx( LOG_TLOG, 7 );
+    tlog( TLOG_FMT_NTP_SELECTED, 0, 2 );
+    tlog( "no arguments, 100%% tokenised" );
+    tlog_drain();
+
+    // ring full, dropped records reported
+    for ( i = 0; i < BATCH * 2; i++ )
+        log_display( LOG_TLOG, i );
+    tlog_drain();
+
+    fclose( tlog_host_output );
+    tlog_host_output = NULL;
+    return 0;
+}
+
+/********************************************************
+* flash_saved()
+*
+* bytes of the clock's format strings, kept out of flash
+* by tlog()
+*********************************************************/
+static unsigned long flash_saved( int *count )
+{
+    static const char *formats[] = { TLOG_FMT_ALL };
+    unsigned long bytes = 0;
+    int i;
+
+    *count = sizeof(formats) / sizeof(formats[0]);
+    for ( i = 0; i < *count; i++ )
+        bytes += strlen( formats[i] ) + 1;
+    return bytes;
+}
+
+/********************************************************
+* usage()
+*********************************************************/
+static void usage( void )
+{
+    printf("Usage: tlog_bench [-n iterations] [-o sample capture file]\n");
+}
+
+/********************************************************
+* main()
+*
+* main program body
+*********************************************************/
+int main( int argc, char *argv[] )
+{
+    const char *sample = NULL;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "n:o:h" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'n': iterations = atoi( optarg ); break;
+            case 'o': sample = optarg; break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if ( iterations < 1 )
+    {
+        usage();
+        return 1;
+    }
+
+    if ( sample )
+        return write_sample( sample ) ? 1 : 0;
+
+    null_fp = fopen( "/dev/null", "w" );
+    if ( !null_fp )
+    {
+        perror("/dev/null");
+        return 1;
+    }
+
+    printf("%d calls per log line, per call cost (ns, cycles) and bytes per line\n\n", iterations);
+    printf("%-10s", "line");
+    for ( opt = 0; opt < LOG_NUM_METHODS; opt++ )
+        printf(" %8s %7s", method_names[opt], "cycles");
+    printf(" %7s %7s\n", "frame B", "text B");
+
+    run( "display", log_display );
+    run( "ntp rx", log_ntp_rx );
+
+    printf("\nflash saved: %lu bytes of format strings", flash_saved( &opt ));
+    printf(" (%d clock log lines in .tlog_fmt)\n", opt);
+
+    fclose( null_fp );
+    return 0;
+}
@@ -0,0 +1,430 @@
+/********************************************************
+* tlog_decode.c
+*
+* Decode tokenised log frames (tlog.c) in a UART capture
+*
+* Format strings are read from the .tlog_fmt section of
+* the firmware ELF (32 or 64 bit, so the host build used
+* by tlog_bench can be decoded too). Text between frames
+* is passed through unchanged, each frame is printed as
+*
+*   [seconds.us] c<core> <formatted text>
+*
+* Frames with a bad checksum or an unknown format string
+* are counted and reported at the end.
+*
+* -s prints the string table size, the flash the format
+* strings would take if they were printf() arguments.
+*
+* Build:
+*   gcc -O2 -I.. -o tlog_decode tlog_decode.c
+*********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <elf.h>
+
+#include "tlog.h"
+
+#define FRAME_MAX 256
+
+typedef struct
+{
+    uint8_t *data;
+    uint64_t addr;
+    uint64_t size;
+} string_table_t;
+
+static string_table_t strings;
+
+static unsigned long frames = 0;
+static unsigned long bad_frames = 0;
+static unsigned long unknown_ids = 0;
+static unsigned long dropped = 0;
+
+/********************************************************
+* read_file()
+*********************************************************/
+static uint8_t *read_file( const char *path, size_t *len )
+{
+    FILE *fp = fopen( path, "rb" );
+    uint8_t *data;
+    long size;
+
+    if ( !fp )
+    {
+        perror( path );
+        return NULL;
+    }
+    fseek( fp, 0, SEEK_END );
+    size = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
+    data = malloc( size > 0 ? size : 1 );
+    if ( fread( data, 1, size, fp ) != (size_t)size )
+    {
+        perror( path );
+        free( data );
+        data = NULL;
+    }
+    fclose( fp );
+    *len = size;
+    return data;
+}
+
+/********************************************************
+* load_strings()
+*
+* find .tlog_fmt section in ELF file
+*********************************************************/
+static int load_strings( const char *path )
+{
+    size_t len;
+    uint8_t *elf = read_file( path, &len );
+    uint64_t shoff, offset = 0;
+    int shnum, shstrndx, shentsize, i;
+    bool is64;
+    const char *shstr;
+
+    if ( !elf )
+        return -1;
+    if ( ( len < EI_NIDENT ) || ( memcmp( elf, ELFMAG, SELFMAG ) != 0 ) )
+    {
+        printf("%s: not an ELF file\n", path);
+        return -1;
+    }
+
+    is64 = elf[EI_CLASS] == ELFCLASS64;
+    if ( is64 )
+    {
+        Elf64_Ehdr *eh = (Elf64_Ehdr *)elf;
+        shoff = eh->e_shoff; shnum = eh->e_shnum; shstrndx = eh->e_shstrndx; shentsize = eh->e_shentsize;
+    }
+    else
+    {
+        Elf32_Ehdr *eh = (Elf32_Ehdr *)elf;
+        shoff = eh->e_shoff; shnum = eh->e_shnum; shstrndx = eh->e_shstrndx; shentsize = eh->e_shentsize;
+    }
+
+    if ( ( shoff + (uint64_t)shnum * shentsize > len ) || ( shstrndx >= shnum ) )
+    {
+        printf("%s: bad section headers\n", path);
+        return -1;
+    }
+
+    // section header fields used, read for either ELF class
+#define SH_FIELD( i, field ) ( is64 ? ((Elf64_Shdr *)( elf + shoff + (i) * shentsize ))->field \
+                                    : ((Elf32_Shdr *)( elf + shoff + (i) * shentsize ))->field )
+
+    shstr = (const char *)elf + SH_FIELD( shstrndx, sh_offset );
+    for ( i = 0; i < shnum; i++ )
+    {
+        if ( strcmp( shstr + SH_FIELD( i, sh_name ), TLOG_FMT_SECTION ) == 0 )
+        {
+            offset = SH_FIELD( i, sh_offset );
+            strings.addr = SH_FIELD( i, sh_addr );
+            strings.size = SH_FIELD( i, sh_size );
+            break;
+        }
+    }
+#undef SH_FIELD
+
+    if ( ( i == shnum ) || ( offset + strings.size > len ) )
+    {
+        printf("%s: no %s section\n", path, TLOG_FMT_SECTION);
+        return -1;
+    }
+
+    strings.data = malloc( strings.size + 1 );
+    memcpy( strings.data, elf + offset, strings.size );
+    strings.data[strings.size] = '\0';
+    free( elf );
+    return 0;
+}
+
+/********************************************************
+* print_string_table()
+*********************************************************/
+static void print_string_table( void )
+{
+    uint64_t i = 0;
+    int count = 0;
+
+    while ( i < strings.size )
+    {
+        const char *fmt = (const char *)strings.data + i;
+        if ( *fmt )
+        {
+            printf("%08llx  %s\n", (unsigned long long)( strings.addr + i ), fmt);
+            count++;
+        }
+        i += strlen( fmt ) + 1;
+    }
+    printf("%d format strings, %llu bytes\n", count, (unsigned long long)strings.size);
+}
+
+/********************************************************
+* format_record()
+*
+* printf() the format string one conversion at a time,
+* args are 32 bit integers
+*********************************************************/
+static void format_record( const char *fmt, uint32_t nargs, const uint32_t *args )
+{
+    uint32_t arg = 0;
+
+    while ( *fmt )
+    {
+        char spec[32];
+        int n = 0;
+
+        if ( *fmt != '%' )
+        {
+            putchar( *fmt++ );
+            continue;
+        }
+        if ( fmt[1] == '%' )
+        {
+            putchar( '%' );
+            fmt += 2;
+            continue;
+        }
+
+        // flags, width, precision, length modifiers dropped
+        spec[n++] = *fmt++;
+        while ( *fmt && strchr( "-+ #0123456789.", *fmt ) && ( n < (int)sizeof(spec) - 2 ) )
+            spec[n++] = *fmt++;
+        while ( *fmt && strchr( "hlLqjzt", *fmt ) )
+            fmt++;
+        if ( !*fmt )
+            break;
+        spec[n++] = *fmt;
+        spec[n] = '\0';
+
+        if ( arg >= nargs )
+        {
+            printf("<missing>");
+        }
+        else if ( strchr( "di", *fmt ) )
+        {
+            printf( spec, (int32_t)args[arg++] );
+        }
+        else if ( strchr( "uxXoc", *fmt ) )
+        {
+            printf( spec, args[arg++] );
+        }
+        else
+        {
+            printf("<%%%c?>", *fmt);
+            arg++;
+        }
+        fmt++;
+    }
+}
+
+/********************************************************
+* get_varint()
+*********************************************************/
+static bool get_varint( const uint8_t **p, const uint8_t *end, uint32_t *value )
+{
+    int shift = 0;
+
+    *value = 0;
+    while ( ( *p < end ) && ( shift < 35 ) )
+    {
+        uint8_t b = *(*p)++;
+        *value |= (uint32_t)( b & 0x7F ) << shift;
+        if ( !( b & 0x80 ) )
+            return true;
+        shift += 7;
+    }
+    return false;
+}
+
+/********************************************************
+* decode_frame()
+*
+* COBS decode, check and print one frame
+*********************************************************/
+static void decode_frame( const uint8_t *frame, int len )
+{
+    uint8_t payload[FRAME_MAX];
+    const uint8_t *p, *end;
+    uint32_t args[TLOG_MAX_ARGS];
+    uint32_t time_us, id, nargs, i;
+    uint8_t flags, sum = 0;
+    int in = 0, out = 0;
+
+    while ( in < len )
+    {
+        int code = frame[in++];
+        int j;
+
+        if ( ( code == 0 ) || ( in + code - 1 > len ) )
+        {
+            bad_frames++;
+            return;
+        }
+        for ( j = 1; j < code; j++ )
+            payload[out++] = frame[in++];
+        if ( ( code < 0xFF ) && ( in < len ) )
+            payload[out++] = 0x00;
+    }
+
+    if ( out < 7 )
+    {
+        bad_frames++;
+        return;
+    }
+    for ( i = 0; i < (uint32_t)out - 1; i++ )
+        sum += payload[i];
+    if ( sum != payload[out - 1] )
+    {
+        bad_frames++;
+        return;
+    }
+
+    p = payload;
+    end = payload + out - 1;
+    flags = *p++;
+    time_us = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+    p += 4;
+    nargs = flags & TLOG_NARGS_MASK;
+    if ( ( nargs > TLOG_MAX_ARGS ) || !get_varint( &p, end, &id ) )
+    {
+        bad_frames++;
+        return;
+    }
+    for ( i = 0; i < nargs; i++ )
+    {
+        if ( !get_varint( &p, end, &args[i] ) )
+        {
+            bad_frames++;
+            return;
+        }
+    }
+
+    frames++;
+    printf("[%5u.%06u] c%d ", time_us / 1000000, time_us % 1000000, flags & TLOG_FLAG_CORE1 ? 1 : 0);
+    if ( flags & TLOG_FLAG_DROPPED )
+    {
+        dropped += args[0];
+        printf("%u records dropped", args[0]);
+    }
+    else if ( ( id < strings.addr ) || ( id - strings.addr >= strings.size ) )
+    {
+        unknown_ids++;
+        printf("<unknown format %08x>", id);
+    }
+    else
+    {
+        format_record( (const char *)strings.data + ( id - strings.addr ), nargs, args );
+    }
+    printf("\n");
+}
+
+/********************************************************
+* decode_stream()
+*
+* pass through text, decode frames between 0x00 bytes
+*********************************************************/
+static void decode_stream( FILE *fp )
+{
+    uint8_t frame[FRAME_MAX];
+    bool in_frame = false;
+    int len = 0;
+    int c;
+
+    while ( ( c = fgetc( fp ) ) != EOF )
+    {
+        if ( !in_frame )
+        {
+            if ( c == 0x00 )
+            {
+                in_frame = true;
+                len = 0;
+            }
+            else
+            {
+                putchar( c );
+            }
+        }
+        else if ( c == 0x00 )
+        {
+            // empty frame: the previous 0x00 ended a lost frame
+            if ( len )
+            {
+                decode_frame( frame, len );
+                in_frame = false;
+            }
+        }
+        else if ( len < FRAME_MAX )
+        {
+            frame[len++] = c;
+        }
+        else
+        {
+            bad_frames++;
+            in_frame = false;
+        }
+    }
+}
+
+/********************************************************
+* usage()
+*********************************************************/
+static void usage( void )
+{
+    printf("Usage: tlog_decode [-s] <firmware.elf> [uart_capture]\n");
+}
+
+/********************************************************
+* main()
+*
+* main program body
+*********************************************************/
+int main( int argc, char *argv[] )
+{
+    bool show_strings = false;
+    FILE *fp = stdin;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "sh" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 's': show_strings = true; break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if ( optind >= argc )
+    {
+        usage();
+        return 1;
+    }
+
+    if ( load_strings( argv[optind] ) )
+        return 1;
+
+    if ( show_strings )
+    {
+        print_string_table();
+        return 0;
+    }
+
+    if ( ( optind + 1 < argc ) && !( fp = fopen( argv[optind + 1], "rb" ) ) )
+    {
+        perror( argv[optind + 1] );
+        return 1;
+    }
+
+    decode_stream( fp );
+
+    fprintf( stderr, "%lu frames, %lu bad, %lu unknown format, %lu records dropped on the clock\n",
+             frames, bad_frames, unknown_ids, dropped );
+    return 0;
+}
@@ -0,0 +1,768 @@
+/********************************************************
+* trace_replay.c
+*
+* Replay an event trace dumped by the clock (trace.c)
+* through the host build of the clock's logic
+* (ntp_packet.c, ntp_race.c, clock_time.c)
+*
+* - NTP responses are re-validated with the clock's
+*   ntp_parse_response(); the display becomes synced, and
+*   the zone changes, only at the NTP sync event the clock
+*   records for the race winner it sets the RTC from
+* - the NTP server race is re-run with ntp_race.c from the
+*   recorded request & reply times and any disagreement
+*   with the clock's NTP sync event is reported
+* - RTC reads are re-formatted as the main loop does and
+*   compared with the LCD frames recorded on the device
+* - stuck DNS requests & invalid NTP response bursts are
+*   reported
+* - device display update time, modelled I2C bus cost and
+*   host CPU cost of the replayed logic are reported so
+*   versions can be compared
+* - boot phase timeline, time-to-first-valid-display and
+*   the estimated time for the same phases run in series
+*
+* Display is assumed NTP synced at the start of a trace
+* unless the trace contains the boot start phase
+*
+* Input is a UART capture containing TRACE BEGIN/END hex
+* dumps (the last dump is used) or a raw binary trace (-b)
+*
+* Build:
+*   gcc -O2 -I.. -o trace_replay trace_replay.c ../ntp_packet.c ../ntp_race.c ../clock_time.c ../boot_phase.c
+*********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "ntp_packet.h"
+#include "ntp_race.h"
+#include "clock_time.h"
+#include "trace.h"
+#include "boot_phase.h"
+
+#define MAX_TRACE_BYTES (1024 * 1024)
+#define MAX_REPORTS     10
+
+// DNS request with no response for this long is reported as stuck
+#define DNS_STUCK_US    (5 * 1000000ULL)
+
+// NTP replies are accepted from the most recent DNS results, the
+// clock races requests to every configured server (ntp_race.c)
+#define MAX_SERVER_ADDRS 8
+
+// the clock polls the race every 10ms (ntp_get_time())
+#define RACE_POLL_US    10000
+
+// trace times are taken next to the clock's race times, not at them
+#define RACE_DELAY_TOLERANCE_US 1000
+
+// lwIP ERR_INPROGRESS, DNS_SENT result of a lookup in progress
+#define DNS_ERR_INPROGRESS (-5)
+
+// HD44780 cost model (hd44780_lcd_api.c): each byte is 6 single byte
+// I2C writes (~20 bit times at 400KHz) and 6 x 500us enable delays
+#define LCD_I2C_WRITES_PER_BYTE 6
+#define LCD_I2C_WRITE_US        50
+#define LCD_DELAY_US_PER_BYTE   (6 * 500)
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t len;
+    uint64_t time_us;       // unwrapped time_us_32()
+    const uint8_t *payload;
+} trace_event_record_t;
+
+typedef struct
+{
+    unsigned long count;
+    double host_ns;
+} event_cost_t;
+
+// NTP server race re-run from the trace
+typedef struct
+{
+    ntp_race_t race;
+    bool started;           // first request of the race seen
+    bool synced;            // clock recorded an NTP sync for the race
+    uint64_t next_poll_us;
+    uint32_t addr[NTP_RACE_MAX_CANDIDATES];     // IPv4 address, 0 = IPv6
+    int server[NTP_RACE_MAX_CANDIDATES];
+    int dns_pending;        // lookups in progress, the clock's more_candidates
+    unsigned long races;
+    unsigned long agree;
+    unsigned long disagree;
+} race_replay_t;
+
+static char *event_names[TRACE_EVENT_NUM_TYPES] = { "?", "rtc", "ntp tx", "ntp rx", "dns sent", "dns result", "wifi", "lcd", "boot", "ntp sync" };
+
+static uint8_t trace_bytes[MAX_TRACE_BYTES];
+static int verbose = 0;
+static unsigned long corrupt_records = 0;
+
+// minimum payload length of each event type, shorter records are corrupt
+static const uint8_t min_payload_len[TRACE_EVENT_NUM_TYPES] =
+{
+    [TRACE_EVENT_RTC_READ]    = sizeof(trace_datetime_t),
+    [TRACE_EVENT_NTP_TX]      = sizeof(trace_ntp_tx_t),
+    [TRACE_EVENT_NTP_RX]      = sizeof(trace_ntp_rx_t),
+    [TRACE_EVENT_DNS_SENT]    = 1,
+    [TRACE_EVENT_DNS_RESULT]  = sizeof(uint32_t),
+    [TRACE_EVENT_WIFI_STATUS] = 2,
+    [TRACE_EVENT_LCD_FRAME]   = 1,
+    [TRACE_EVENT_BOOT_PHASE]  = 1,
+    [TRACE_EVENT_NTP_SYNC]    = sizeof(trace_ntp_sync_t),
+};
+
+/********************************************************
+* host_ns()
+*********************************************************/
+static double host_ns( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/********************************************************
+* get_le32()
+*********************************************************/
+static uint32_t get_le32( const uint8_t *buf )
+{
+    return (uint32_t)buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+/********************************************************
+* is_server_addr()
+*********************************************************/
+static bool is_server_addr( const uint32_t *server_addrs, uint32_t addr )
+{
+    int i;
+
+    for ( i = 0; i < MAX_SERVER_ADDRS; i++ )
+    {
+        if ( ( addr != 0 ) && ( server_addrs[i] == addr ) )
+            return true;
+    }
+    return false;
+}
+
+/********************************************************
+* load_uart_capture()
+*
+* decode hex of last TRACE BEGIN/END block
+* returns number of trace bytes, -1 if no block found
+*********************************************************/
+static long load_uart_capture( FILE *fp )
+{
+    char line[1024];
+    long len = -1;
+    bool in_trace = false;
+
+    while ( fgets( line, sizeof(line), fp ) )
+    {
+        if ( strncmp( line, "TRACE BEGIN", 11 ) == 0 )
+        {
+            in_trace = true;
+            len = 0;
+        }
+        else if ( strncmp( line, "TRACE END", 9 ) == 0 )
+        {
+            in_trace = false;
+        }
+        else if ( in_trace )
+        {
+            char *p = line;
+            unsigned int byte;
+            while ( ( len < MAX_TRACE_BYTES ) && ( sscanf( p, "%2x", &byte ) == 1 ) )
+            {
+                trace_bytes[len++] = byte;
+                p += 2;
+            }
+        }
+    }
+    return len;
+}
+
+/********************************************************
+* parse_records()
+*
+* split trace bytes into records, unwrap timestamps
+* records too short for their type are skipped & counted
+* returns number of records
+*********************************************************/
+static int parse_records( long len, trace_event_record_t **records )
+{
+    trace_event_record_t *rec;
+    uint32_t last_ts = 0;
+    uint64_t wrap = 0;
+    long pos = 0;
+    int count = 0;
+
+    rec = malloc( sizeof(trace_event_record_t) * ( len / TRACE_HEADER_LEN + 1 ) );
+
+    while ( pos + TRACE_HEADER_LEN <= len )
+    {
+        uint8_t type = trace_bytes[pos];
+        uint8_t rec_len = trace_bytes[pos+1];
+        uint32_t ts = get_le32( &trace_bytes[pos+2] );
+
+        if ( ( type == 0 ) || ( type >= TRACE_EVENT_NUM_TYPES ) || ( pos + TRACE_HEADER_LEN + rec_len > len ) )
+        {
+            printf("corrupt trace at byte %ld\n", pos);
+            corrupt_records++;
+            break;
+        }
+        if ( ( count > 0 ) && ( ts < last_ts ) && ( last_ts - ts > 0x80000000u ) )
+            wrap += 1ULL << 32;
+        last_ts = ts;
+
+        if ( rec_len < min_payload_len[type] )
+        {
+            if ( corrupt_records++ < MAX_REPORTS )
+                printf("corrupt %s record at byte %ld: %u byte payload\n", event_names[type], pos, rec_len);
+            pos += TRACE_HEADER_LEN + rec_len;
+            continue;
+        }
+
+        rec[count].type = type;
+        rec[count].len = rec_len;
+        rec[count].time_us = wrap + ts;
+        rec[count].payload = &trace_bytes[pos + TRACE_HEADER_LEN];
+        count++;
+        pos += TRACE_HEADER_LEN + rec_len;
+    }
+    *records = rec;
+    return count;
+}
+
+/********************************************************
+* race_replay_poll()
+*
+* poll the race as the clock does up to now_us
+*********************************************************/
+static void race_replay_poll( race_replay_t *rr, uint64_t now_us )
+{
+    while ( rr->started && ( rr->race.state == NTP_RACE_RUNNING ) && ( rr->next_poll_us <= now_us ) )
+    {
+        ntp_race_poll( &rr->race, rr->next_poll_us, rr->dns_pending > 0 );
+        rr->next_poll_us += RACE_POLL_US;
+    }
+}
+
+/********************************************************
+* race_replay_disagree()
+*********************************************************/
+static void race_replay_disagree( race_replay_t *rr, uint64_t time_us, const char *what )
+{
+    if ( rr->disagree++ < MAX_REPORTS )
+        printf("%12.3f  ntp race replay disagrees: %s\n", time_us / 1e6, what);
+}
+
+/********************************************************
+* race_replay_end()
+*
+* previous race ended without a clock NTP sync, the
+* replayed race should not have selected a reply either
+*********************************************************/
+static void race_replay_end( race_replay_t *rr, uint64_t time_us )
+{
+    if ( !rr->started || rr->synced )
+        return;
+
+    race_replay_poll( rr, time_us );
+    if ( rr->race.state == NTP_RACE_DONE )
+        race_replay_disagree( rr, time_us, "replay selected a reply, clock did not sync" );
+    else
+        rr->agree++;
+}
+
+/********************************************************
+* race_replay_tx()
+*
+* the first request of a race starts the replayed race,
+* its timeout runs from this request rather than from
+* before the clock's DNS lookups
+*********************************************************/
+static void race_replay_tx( race_replay_t *rr, const trace_event_record_t *r )
+{
+    trace_ntp_tx_t tx;
+    int candidate;
+
+    memcpy( &tx, r->payload, sizeof(tx) );
+
+    if ( tx.candidate == 0 )
+    {
+        race_replay_end( rr, r->time_us );
+        ntp_race_start( &rr->race, r->time_us, NTP_RACE_GOOD_DELAY_MS * 1000, NTP_RACE_GRACE_MS * 1000, NTP_RACE_TIMEOUT_MS * 1000 );
+        rr->started = true;
+        rr->synced = false;
+        rr->next_poll_us = r->time_us + RACE_POLL_US;
+        rr->races++;
+    }
+    if ( !rr->started )
+        return;
+
+    race_replay_poll( rr, r->time_us );
+    candidate = ntp_race_add( &rr->race, r->time_us );
+    if ( candidate >= 0 )
+    {
+        rr->addr[candidate] = tx.addr;
+        rr->server[candidate] = tx.server;
+    }
+    if ( candidate != tx.candidate )
+    {
+        char what[80];
+        snprintf( what, sizeof(what), "request to server %d is candidate %d, clock %u", tx.server, candidate, tx.candidate );
+        race_replay_disagree( rr, r->time_us, what );
+    }
+}
+
+/********************************************************
+* race_replay_rx()
+*
+* pass reply to the race, matched to a candidate by
+* address as ntp_receive() does; IPv6 replies go to the
+* first IPv6 candidate yet to respond
+*********************************************************/
+static void race_replay_rx( race_replay_t *rr, const trace_event_record_t *r )
+{
+    trace_ntp_rx_t rx;
+    ntp_response_result_t result;
+    uint16_t len = r->len - sizeof(rx);
+    int candidate = -1;
+    int i;
+
+    race_replay_poll( rr, r->time_us );
+    if ( !rr->started || ( rr->race.state != NTP_RACE_RUNNING ) )
+        return;
+
+    memcpy( &rx, r->payload, sizeof(rx) );
+    for ( i = 0; ( i < rr->race.num_candidates ) && ( rx.port == NTP_PORT ); i++ )
+    {
+        if ( ( rr->addr[i] == rx.addr ) && ( ( rx.addr != 0 ) || ( ( candidate < 0 ) && !rr->race.candidates[i].responded ) ) )
+            candidate = i;
+    }
+
+    // payload holds up to NTP_MESSAGE_LEN bytes of the datagram
+    if ( len == NTP_MESSAGE_LEN )
+        len = rx.tot_len;
+    ntp_race_response( &rr->race, candidate, r->payload + sizeof(rx), len, r->time_us, &result );
+}
+
+/********************************************************
+* race_replay_sync()
+*
+* compare the replayed race winner with the clock's NTP
+* sync event
+*********************************************************/
+static void race_replay_sync( race_replay_t *rr, const trace_event_record_t *r, const trace_ntp_sync_t *sync )
+{
+    const ntp_race_t *race = &rr->race;
+    char what[96];
+    int64_t correction_ms;
+
+    race_replay_poll( rr, r->time_us );
+    if ( !rr->started || rr->synced )
+        return;
+    rr->synced = true;
+
+    if ( race->state != NTP_RACE_DONE )
+    {
+        snprintf( what, sizeof(what), "replay race %s, clock synced from server %d",
+                  race->state == NTP_RACE_RUNNING ? "still running" : "failed", sync->server );
+        race_replay_disagree( rr, r->time_us, what );
+        return;
+    }
+
+    correction_ms = ( ntp_fraction_to_us( race->best_resp.transmit_fraction ) + race->best_delay_us / 2 + ( r->time_us - race->best_response_us ) ) / 1000;
+
+    if ( ( rr->server[race->best] != sync->server ) || ( race->best_resp.transmit_seconds != sync->transmit_seconds ) )
+    {
+        snprintf( what, sizeof(what), "replay selected server %d delay %.1fms, clock server %d delay %.1fms",
+                  rr->server[race->best], race->best_delay_us / 1e3, sync->server, sync->delay_us / 1e3 );
+        race_replay_disagree( rr, r->time_us, what );
+    }
+    else if ( llabs( race->best_delay_us - (int64_t)sync->delay_us ) > RACE_DELAY_TOLERANCE_US )
+    {
+        snprintf( what, sizeof(what), "server %d delay %.1fms, clock %.1fms",
+                  sync->server, race->best_delay_us / 1e3, sync->delay_us / 1e3 );
+        race_replay_disagree( rr, r->time_us, what );
+    }
+    else if ( ( correction_ms + 500 ) / 1000 != ( sync->correction_ms + 500 ) / 1000 )
+    {
+        snprintf( what, sizeof(what), "RTC set %lld ms after reply second, clock %u ms",
+                  (long long)correction_ms, sync->correction_ms );
+        race_replay_disagree( rr, r->time_us, what );
+    }
+    else
+    {
+        rr->agree++;
+    }
+}
+
+/********************************************************
+* report_boot()
+*
+* boot phase timeline & serial boot estimate
+*********************************************************/
+static void report_boot( const uint64_t *phase_us, const bool *phase_seen, double display_update_ms )
+{
+    int i;
+
+    if ( !phase_seen[BOOT_PHASE_START] )
+        return;
+
+    printf("\nboot phases\n");
+    for ( i = 0; i < BOOT_PHASE_NUM_PHASES; i++ )
+    {
+        if ( phase_seen[i] )
+            printf("  %-28s %9.1f ms\n", boot_phase_name( i ), ( phase_us[i] - phase_us[BOOT_PHASE_START] ) / 1e3);
+    }
+
+    if ( phase_seen[BOOT_PHASE_FIRST_DISPLAY] )
+        printf("  time to first display        %9.1f ms\n", ( phase_us[BOOT_PHASE_FIRST_DISPLAY] - phase_us[BOOT_PHASE_START] ) / 1e3);
+
+    if ( phase_seen[BOOT_PHASE_FIRST_VALID_DISPLAY] && phase_seen[BOOT_PHASE_LCD_INIT_START] && phase_seen[BOOT_PHASE_LCD_INIT_DONE] &&
+         phase_seen[BOOT_PHASE_CYW43_INIT_START] && phase_seen[BOOT_PHASE_NTP_SYNCED] )
+    {
+        // LCD init, then Wi-Fi/NTP, then a display update, one after the other
+        double serial_ms = ( phase_us[BOOT_PHASE_LCD_INIT_DONE] - phase_us[BOOT_PHASE_LCD_INIT_START] ) / 1e3 +
+                           ( phase_us[BOOT_PHASE_NTP_SYNCED] - phase_us[BOOT_PHASE_CYW43_INIT_START] ) / 1e3 +
+                           display_update_ms;
+
+        printf("  time to first valid display  %9.1f ms (serial boot estimate %.1f ms)\n",
+               ( phase_us[BOOT_PHASE_FIRST_VALID_DISPLAY] - phase_us[BOOT_PHASE_START] ) / 1e3, serial_ms);
+    }
+}
+
+/********************************************************
+* replay()
+*
+* feed records through the clock logic
+*********************************************************/
+static void replay( const trace_event_record_t *rec, int count )
+{
+    event_cost_t cost[TRACE_EVENT_NUM_TYPES] = { { 0 } };
+    char expected[2][CLOCK_LINE_LEN] = { "", "" };
+    uint64_t phase_us[BOOT_PHASE_NUM_PHASES] = { 0 };
+    bool phase_seen[BOOT_PHASE_NUM_PHASES] = { false };
+    bool synced = true;
+    bool is_dst = false;
+    bool dns_pending = false;
+    bool have_rtc_read = false;
+    bool race_running = false;
+    uint64_t dns_sent_us = 0;
+    uint64_t ntp_tx_us = 0;
+    uint64_t rtc_read_us = 0;
+    uint32_t server_addrs[MAX_SERVER_ADDRS] = { 0 };
+    int next_server_addr = 0;
+    unsigned long lcd_frames = 0, lcd_matched = 0, lcd_mismatched = 0, lcd_bytes = 0;
+    unsigned long display_updates = 0, syncs = 0, valid_replies = 0, late_replies = 0, stuck_dns = 0;
+    unsigned long ntp_results[NTP_RESPONSE_NUM_RESULTS] = { 0 };
+    unsigned long invalid_burst = 0, max_invalid_burst = 0, invalid_source = 0;
+    uint64_t display_us_total = 0, display_us_max = 0;
+    race_replay_t rr = { 0 };
+    int reports = 0;
+    int i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        const trace_event_record_t *r = &rec[i];
+        double start;
+
+        if ( dns_pending && ( r->time_us - dns_sent_us > DNS_STUCK_US ) )
+        {
+            printf("%12.3f  stuck dns request: no result/response %.1fs after request\n", dns_sent_us / 1e6, ( r->time_us - dns_sent_us ) / 1e6);
+            stuck_dns++;
+            dns_pending = false;
+        }
+
+        race_replay_poll( &rr, r->time_us );
+
+        switch ( r->type )
+        {
+            case TRACE_EVENT_RTC_READ:
+            {
+                trace_datetime_t td;
+                datetime_t t;
+
+                memcpy( &td, r->payload, sizeof(td) );
+                t.year = td.year;
+                t.month = td.month;
+                t.day = td.day;
+                t.dotw = td.dotw;
+                t.hour = td.hour;
+                t.min = td.min;
+                t.sec = td.sec;
+                start = host_ns();
+                clock_format_lines( &t, is_dst, synced, expected[0], expected[1] );
+                cost[r->type].host_ns += host_ns() - start;
+                rtc_read_us = r->time_us;
+                have_rtc_read = true;
+                break;
+            }
+            case TRACE_EVENT_LCD_FRAME:
+            {
+                char text[CLOCK_LINE_LEN] = { 0 };
+                int row = r->payload[0];
+                int len = r->len - 1;
+
+                if ( len > CLOCK_LINE_LEN - 1 )
+                    len = CLOCK_LINE_LEN - 1;
+                memcpy( text, &r->payload[1], len );
+                lcd_frames++;
+                // set cursor command + characters
+                lcd_bytes += 1 + len;
+
+                if ( have_rtc_read && ( row < 2 ) )
+                {
+                    if ( strcmp( text, expected[row] ) == 0 )
+                    {
+                        lcd_matched++;
+                    }
+                    else
+                    {
+                        lcd_mismatched++;
+                        if ( reports++ < MAX_REPORTS )
+                            printf("%12.3f  lcd row %d mismatch: device \"%s\" replay \"%s\"\n", r->time_us / 1e6, row, text, expected[row]);
+                    }
+                    if ( row == 1 )
+                    {
+                        uint64_t us = r->time_us - rtc_read_us;
+                        display_us_total += us;
+                        if ( us > display_us_max )
+                            display_us_max = us;
+                        display_updates++;
+                    }
+                }
+                if ( verbose )
+                    printf("%12.3f  lcd %d \"%s\"\n", r->time_us / 1e6, row, text);
+                break;
+            }
+            case TRACE_EVENT_NTP_TX:
+                // first request after a sync starts the next race
+                race_running = true;
+                ntp_tx_us = r->time_us;
+                start = host_ns();
+                race_replay_tx( &rr, r );
+                cost[r->type].host_ns += host_ns() - start;
+                break;
+            case TRACE_EVENT_NTP_RX:
+            {
+                trace_ntp_rx_t rx;
+                ntp_response_t resp;
+                ntp_response_result_t result = NTP_RESPONSE_BAD_LENGTH;
+                struct in_addr in;
+
+                memcpy( &rx, r->payload, sizeof(rx) );
+                in.s_addr = rx.addr;
+
+                // source & validity only, the race decides which reply is used (NTP sync event);
+                // IPv6 sources are traced as address 0 so their address is not checked
+                start = host_ns();
+                if ( ( ( rx.addr != 0 ) && !is_server_addr( server_addrs, rx.addr ) ) || ( rx.port != NTP_PORT ) )
+                    invalid_source++;
+                else if ( rx.tot_len == NTP_MESSAGE_LEN )
+                    result = ntp_parse_response( r->payload + sizeof(rx), r->len - sizeof(rx), &resp );
+
+                ntp_results[result]++;
+                if ( result == NTP_RESPONSE_OK )
+                {
+                    datetime_t t;
+                    bool dst = clock_ntp_to_datetime( resp.transmit_seconds, &t );
+                    cost[r->type].host_ns += host_ns() - start;
+                    valid_replies++;
+                    if ( !race_running )
+                        late_replies++;
+                    invalid_burst = 0;
+                    printf("%12.3f  ntp reply from %s rtt %.1fms stratum %d => %04d-%02d-%02d %02d:%02d:%02d %s%s\n",
+                           r->time_us / 1e6, rx.addr ? inet_ntoa( in ) : "IPv6", ( r->time_us - ntp_tx_us ) / 1e3, resp.stratum,
+                           t.year, t.month, t.day, t.hour, t.min, t.sec, dst ? "BST" : "GMT", race_running ? "" : " after race over");
+                }
+                else
+                {
+                    cost[r->type].host_ns += host_ns() - start;
+                    if ( ++invalid_burst > max_invalid_burst )
+                        max_invalid_burst = invalid_burst;
+                    printf("%12.3f  ntp response from %s:%u len %u rejected: %s\n",
+                           r->time_us / 1e6, rx.addr ? inet_ntoa( in ) : "IPv6", rx.port, rx.tot_len, ntp_response_result_str( result ));
+                }
+                start = host_ns();
+                race_replay_rx( &rr, r );
+                cost[r->type].host_ns += host_ns() - start;
+                dns_pending = false;
+                break;
+            }
+            case TRACE_EVENT_NTP_SYNC:
+            {
+                trace_ntp_sync_t sync;
+                datetime_t t;
+
+                // RTC set to the nearest second & synced from the race winner, as ntp_sync()
+                memcpy( &sync, r->payload, sizeof(sync) );
+                start = host_ns();
+                is_dst = clock_ntp_to_datetime( sync.transmit_seconds + ( sync.correction_ms + 500 ) / 1000, &t );
+                race_replay_sync( &rr, r, &sync );
+                cost[r->type].host_ns += host_ns() - start;
+                synced = true;
+                race_running = false;
+                syncs++;
+                printf("%12.3f  ntp sync from server %d of %u candidates delay %.1fms => %04d-%02d-%02d %02d:%02d:%02d %s\n",
+                       r->time_us / 1e6, sync.server, sync.candidates, sync.delay_us / 1e3,
+                       t.year, t.month, t.day, t.hour, t.min, t.sec, is_dst ? "BST" : "GMT");
+                break;
+            }
+            case TRACE_EVENT_DNS_SENT:
+                dns_pending = true;
+                dns_sent_us = r->time_us;
+                if ( (int8_t)r->payload[0] == DNS_ERR_INPROGRESS )
+                    rr.dns_pending++;
+                if ( verbose )
+                    printf("%12.3f  dns request err %d\n", r->time_us / 1e6, (int8_t)r->payload[0]);
+                break;
+            case TRACE_EVENT_DNS_RESULT:
+            {
+                struct in_addr in;
+                uint32_t server_addr = get_le32( r->payload );
+                in.s_addr = server_addr;
+                // approximate, results of cached addresses have no lookup
+                if ( rr.dns_pending > 0 )
+                    rr.dns_pending--;
+                if ( server_addr == 0 )
+                    dns_pending = false;
+                else if ( !is_server_addr( server_addrs, server_addr ) )
+                    server_addrs[next_server_addr++ % MAX_SERVER_ADDRS] = server_addr;
+                printf("%12.3f  dns result %s\n", r->time_us / 1e6, server_addr ? inet_ntoa( in ) : "failed");
+                break;
+            }
+            case TRACE_EVENT_BOOT_PHASE:
+            {
+                int phase = r->payload[0];
+                if ( phase < BOOT_PHASE_NUM_PHASES )
+                {
+                    phase_us[phase] = r->time_us;
+                    phase_seen[phase] = true;
+                    if ( phase == BOOT_PHASE_START )
+                        synced = false;
+                }
+                break;
+            }
+            case TRACE_EVENT_WIFI_STATUS:
+                printf("%12.3f  wifi connect %d link status %d\n", r->time_us / 1e6, (int8_t)r->payload[0], (int8_t)r->payload[1]);
+                break;
+            default:
+                break;
+        }
+
+        cost[r->type].count++;
+    }
+
+    if ( dns_pending )
+    {
+        uint64_t pending_us = rec[count-1].time_us - dns_sent_us;
+        printf("%12.3f  dns request pending at end of trace (%.1fs)\n", dns_sent_us / 1e6, pending_us / 1e6);
+        if ( pending_us > DNS_STUCK_US )
+            stuck_dns++;
+    }
+
+    printf("\nreplay summary\n");
+    printf("  events              %d over %.1fs\n", count, count ? ( rec[count-1].time_us - rec[0].time_us ) / 1e6 : 0.0);
+    printf("  corrupt records     %lu\n", corrupt_records);
+    printf("  ntp syncs           %lu\n", syncs);
+    printf("  ntp valid replies   %lu (%lu after race over)\n", valid_replies, late_replies);
+    printf("  ntp race replay     %lu races, %lu agree with clock, %lu disagree\n", rr.races, rr.agree, rr.disagree);
+    printf("  ntp rejected        bad source %lu", invalid_source);
+    for ( i = NTP_RESPONSE_BAD_LENGTH; i < NTP_RESPONSE_NUM_RESULTS; i++ )
+        printf(", %s %lu", ntp_response_result_str( i ), ntp_results[i]);
+    printf("\n  max invalid burst   %lu\n", max_invalid_burst);
+    printf("  stuck dns requests  %lu\n", stuck_dns);
+    printf("  lcd frames          %lu (%lu match replay, %lu mismatch)\n", lcd_frames, lcd_matched, lcd_mismatched);
+    if ( display_updates )
+        printf("  display update      mean %.1fms max %.1fms (device, rtc read => lcd row 1)\n",
+               display_us_total / 1e3 / display_updates, display_us_max / 1e3);
+    if ( lcd_frames )
+        printf("  lcd bus cost        %.1f bytes/frame, %.1f I2C writes/frame, %.1fms/frame modelled\n",
+               (double)lcd_bytes / lcd_frames, (double)lcd_bytes * LCD_I2C_WRITES_PER_BYTE / lcd_frames,
+               lcd_bytes * ( LCD_I2C_WRITES_PER_BYTE * LCD_I2C_WRITE_US + LCD_DELAY_US_PER_BYTE ) / 1e3 / lcd_frames);
+    printf("  host logic cost    ");
+    for ( i = 1; i < TRACE_EVENT_NUM_TYPES; i++ )
+    {
+        if ( cost[i].count && cost[i].host_ns )
+            printf(" %s %.0fns", event_names[i], cost[i].host_ns / cost[i].count);
+    }
+    printf("\n");
+
+    report_boot( phase_us, phase_seen, display_updates ? display_us_total / 1e3 / display_updates : 0.0 );
+}
+
+/********************************************************
+* usage()
+*********************************************************/
+static void usage( void )
+{
+    printf("Usage: trace_replay [-b] [-v] <uart capture | binary trace>\n");
+    printf("  -b   input is raw binary trace\n");
+    printf("  -v   list lcd frames and dns requests\n");
+}
+
+/********************************************************
+* main()
+*
+* main program body
+*********************************************************/
+int main( int argc, char *argv[] )
+{
+    trace_event_record_t *records;
+    bool binary = false;
+    FILE *fp;
+    long len;
+    int count;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "bvh" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'b': binary = true; break;
+            case 'v': verbose = 1; break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if ( optind >= argc )
+    {
+        usage();
+        return 1;
+    }
+
+    fp = fopen( argv[optind], binary ? "rb" : "r" );
+    if ( fp == NULL )
+    {
+        perror( argv[optind] );
+        return 1;
+    }
+    if ( binary )
+        len = fread( trace_bytes, 1, sizeof(trace_bytes), fp );
+    else
+        len = load_uart_capture( fp );
+    fclose( fp );
+
+    if ( len < 0 )
+    {
+        printf("no TRACE BEGIN/END block in %s\n", argv[optind]);
+        return 1;
+    }
+
+    count = parse_records( len, &records );
+    replay( records, count );
+    free( records );
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*******************************************************************
+*
+* boot_phase.c
+*
+* Boot phase timestamps for measuring time-to-first-valid-display
+*
+* Also builds on the host (no PICO_ON_DEVICE) for apps/trace_replay,
+* only boot_phase_name() is available there
+*
+********************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#endif
+
+#include "boot_phase.h"
+#include "trace.h"
+
+static const char *phase_names[BOOT_PHASE_NUM_PHASES] = { "start", "lcd init start", "lcd init done", "first display", 
+                                                     "cyw43 init start", "cyw43 init done", "wifi connected", 
+                                                     "dns resolved", "ntp synced", "first valid display" };
+
+/******************************************************************
+*
+* boot_phase_name()
+*
+*******************************************************************/
+const char *boot_phase_name( boot_phase_t phase )
+{
+    return ( phase < BOOT_PHASE_NUM_PHASES ) ? phase_names[phase] : "?";
+}
+
+#if PICO_ON_DEVICE
+
+static uint32_t phase_us[BOOT_PHASE_NUM_PHASES];
+static volatile bool phase_marked[BOOT_PHASE_NUM_PHASES];
+
+/******************************************************************
+*
+* boot_phase_mark()
+*
+* record time of first occurrence of phase
+*
+* each phase is only marked from one core so no locking is needed
+*
+*******************************************************************/
+void boot_phase_mark( boot_phase_t phase )
+{
+    if ( ( phase < BOOT_PHASE_NUM_PHASES ) && !phase_marked[phase] )
+    {
+        uint8_t id = phase;
+
+        phase_us[phase] = time_us_32();
+        phase_marked[phase] = true;
+        trace_record( TRACE_EVENT_BOOT_PHASE, &id, sizeof(id) );
+    }
+}
+
+/******************************************************************
+*
+* boot_phase_report()
+*
+* print boot phase times relative to main() entry
+*
+*******************************************************************/
+void boot_phase_report( void )
+{
+    int i;
+
+    printf("\nboot phases:\n");
+    for ( i = 0; i < BOOT_PHASE_NUM_PHASES; i++ )
+    {
+        if ( phase_marked[i] )
+            printf("  %-20s %8.1f ms\n", boot_phase_name( i ), ( phase_us[i] - phase_us[BOOT_PHASE_START] ) / 1000.0);
+    }
+}
+
+#endif // PICO_ON_DEVICE
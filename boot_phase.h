@@ -0,0 +1,37 @@
+/*******************************************************************
+*
+* boot_phase.h
+*
+* Boot phase timestamps for measuring time-to-first-valid-display
+*
+* Each phase is recorded once, as a TRACE_EVENT_BOOT_PHASE trace
+* event and in a table printed by boot_phase_report()
+*
+* boot_phase_name() is shared with apps/trace_replay
+*
+********************************************************************/
+#ifndef __BOOT_PHASE_H__
+#define __BOOT_PHASE_H__
+
+#include <stdint.h>
+
+typedef enum
+{
+    BOOT_PHASE_START = 0,           // main() entry
+    BOOT_PHASE_LCD_INIT_START,      // core 1
+    BOOT_PHASE_LCD_INIT_DONE,
+    BOOT_PHASE_FIRST_DISPLAY,       // provisional (unsynced) time shown
+    BOOT_PHASE_CYW43_INIT_START,    // core 0
+    BOOT_PHASE_CYW43_INIT_DONE,
+    BOOT_PHASE_WIFI_CONNECTED,
+    BOOT_PHASE_DNS_RESOLVED,
+    BOOT_PHASE_NTP_SYNCED,
+    BOOT_PHASE_FIRST_VALID_DISPLAY, // NTP time shown
+    BOOT_PHASE_NUM_PHASES
+} boot_phase_t;
+
+const char *boot_phase_name( boot_phase_t phase );
+void boot_phase_mark( boot_phase_t phase );
+void boot_phase_report( void );
+
+#endif // __BOOT_PHASE_H__
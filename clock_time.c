@@ -0,0 +1,174 @@
+/*******************************************************************
+*
+* clock_time.c
+*
+* NTP time => local (GMT/BST) time conversion and LCD line formatting
+*
+********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "clock_time.h"
+#include "ntp_packet.h"
+
+#include "bsttimes.h"
+
+static char *dayofweek[7] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static char *months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+static char *timezones[2] = { "GMT", "BST" };
+
+/******************************************************************
+*
+* dst_check()
+*
+* BST is last Sunday in March to last Sunday in October
+*
+* check current time is within bst_start_times & bst_end_times for BST
+*
+* years outside of bsttimes.h are treated as GMT
+*
+*******************************************************************/
+bool dst_check( const time_t unix_format_time, const int year )
+{
+    bool bst;   
+    if ( ( year < BST_START_YEAR ) || ( year >= BST_START_YEAR + BST_NUM_YEARS ) )
+        bst = false;
+    else if ( (unix_format_time > bst_start_times[year-BST_START_YEAR] ) && (unix_format_time < bst_end_times[year-BST_START_YEAR] ) )
+        bst = true;
+    else
+        bst = false;             
+
+   return bst;
+}
+
+/******************************************************************
+*
+* clock_ntp_to_datetime()
+*
+* convert NTP seconds to local time (GMT or BST)
+*
+* returns true if BST
+*
+*******************************************************************/
+bool clock_ntp_to_datetime( uint32_t ntp_seconds, datetime_t *t )
+{
+    time_t unix_epoch;
+    struct tm ntp_tm;
+    bool is_dst;
+
+    //NTP epoch 1900 => Unix epoch 1970
+    unix_epoch = ntp_to_unix_seconds( ntp_seconds );
+
+    gmtime_r( &unix_epoch, &ntp_tm );
+
+    is_dst = dst_check( unix_epoch, 1900+ntp_tm.tm_year);
+    if ( is_dst )
+    {
+        unix_epoch += BST_OFFSET;
+        gmtime_r( &unix_epoch, &ntp_tm );
+    }
+
+    t->year = 1900 + ntp_tm.tm_year;
+    t->month = 1 + ntp_tm.tm_mon;
+    t->day = ntp_tm.tm_mday;
+    t->dotw = ntp_tm.tm_wday;
+    t->hour = ntp_tm.tm_hour;
+    t->min = ntp_tm.tm_min;
+    t->sec = ntp_tm.tm_sec;
+
+    return is_dst;
+}
+
+/******************************************************************
+*
+* day_of_week()
+*
+* 0 = Sunday, month 1..12
+*
+*******************************************************************/
+static int day_of_week( int year, int month, int day )
+{
+    static const int month_offset[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+
+    if ( month < 3 )
+        year--;
+    return ( year + year/4 - year/100 + year/400 + month_offset[month-1] + day ) % 7;
+}
+
+/******************************************************************
+*
+* clock_format_lines()
+*
+* format date (line0) and time (line1) for the LCD
+*
+* time not yet set from NTP is marked with '?' before the timezone
+*
+* line0 & line1 must be CLOCK_LINE_LEN bytes
+*
+*******************************************************************/
+void clock_format_lines( const datetime_t *t, bool is_dst, bool synced, char *line0, char *line1 )
+{
+    snprintf( line0, CLOCK_LINE_LEN, "%s %02d %s %04d", dayofweek[t->dotw % 7], t->day, months[(t->month+11) % 12], t->year);
+    // fields reduced to 2 digits so the line provably fits CLOCK_LINE_LEN
+    snprintf( line1, CLOCK_LINE_LEN, "%02u:%02u:%02u  %c %3s", (uint8_t)t->hour % 100u, (uint8_t)t->min % 100u, (uint8_t)t->sec % 100u,
+              synced ? ' ' : '?', is_dst ? timezones[1]:timezones[0] );
+}
+
+/******************************************************************
+*
+* clock_build_datetime()
+*
+* firmware build time, last resort provisional time before NTP
+*
+* __DATE__ & __TIME__ are the build host's local time, taken to be
+* UK time like the clock's display
+*
+* returns true if BST
+*
+*******************************************************************/
+bool clock_build_datetime( datetime_t *t )
+{
+    const char *date = __DATE__;    // "Mmm dd yyyy"
+    const char *time = __TIME__;    // "hh:mm:ss"
+    int month;
+
+    for ( month = 0; month < 12; month++ )
+    {
+        if ( strncmp( date, months[month], 3 ) == 0 )
+            break;
+    }
+
+    t->year = atoi( &date[7] );
+    t->month = ( month % 12 ) + 1;
+    t->day = atoi( &date[4] );
+    t->hour = atoi( &time[0] );
+    t->min = atoi( &time[3] );
+    t->sec = atoi( &time[6] );
+    t->dotw = day_of_week( t->year, t->month, t->day );
+
+    // bsttimes.h holds UTC change times, local time is UTC + 1h during BST
+    return dst_check( (time_t)( clock_datetime_to_seconds( t ) - BST_OFFSET ), t->year );
+}
+
+/******************************************************************
+*
+* clock_datetime_to_seconds()
+*
+* seconds since 1 January 1970 for datetime, no timezone adjustment
+*
+*******************************************************************/
+int64_t clock_datetime_to_seconds( const datetime_t *t )
+{
+    int year = t->year - ( t->month <= 2 );
+    int era = ( year >= 0 ? year : year - 399 ) / 400;
+    int year_of_era = year - era * 400;
+    int day_of_year = ( 153 * ( t->month + ( t->month > 2 ? -3 : 9 ) ) + 2 ) / 5 + t->day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era/4 - year_of_era/100 + day_of_year;
+    int64_t days = (int64_t)era * 146097 + day_of_era - 719468;
+
+    return days * 86400 + t->hour * 3600 + t->min * 60 + t->sec;
+}
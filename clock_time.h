@@ -0,0 +1,45 @@
+/*******************************************************************
+*
+* clock_time.h
+*
+* NTP time => local (GMT/BST) time conversion and LCD line formatting
+*
+* No hardware dependencies so the same code is replayed on the host
+*
+********************************************************************/
+#ifndef __CLOCK_TIME_H__
+#define __CLOCK_TIME_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#if PICO_ON_DEVICE
+#include "pico/types.h"
+#else
+// host build: same layout as PICO SDK datetime_t
+typedef struct
+{
+    int16_t year;
+    int8_t month;
+    int8_t day;
+    int8_t dotw;
+    int8_t hour;
+    int8_t min;
+    int8_t sec;
+} datetime_t;
+#endif
+
+// British Summer Time 1 hour offset
+#define BST_OFFSET (60 * 60) 
+
+// LCD line buffer size, HD44780_MAX_CHARS + terminator
+#define CLOCK_LINE_LEN 17
+
+bool dst_check( const time_t unix_format_time, const int year );
+bool clock_ntp_to_datetime( uint32_t ntp_seconds, datetime_t *t );
+void clock_format_lines( const datetime_t *t, bool is_dst, bool synced, char *line0, char *line1 );
+bool clock_build_datetime( datetime_t *t );
+int64_t clock_datetime_to_seconds( const datetime_t *t );
+
+#endif // __CLOCK_TIME_H__
@@ -52,6 +52,15 @@
 #define DHCP_DOES_ARP_CHECK         0
 #define LWIP_DHCP_DOES_ACD_CHECK    0
 
+// concurrent lookups of the NTP server list (ntp_resolver.c)
+#define DNS_TABLE_SIZE              8
+#define MEMP_NUM_UDP_PCB            8
+
+// LWIP_IPV6 set by NTP_CLOCK_IPV6 in CMakeLists.txt
+#if LWIP_IPV6
+#define LWIP_IPV6_AUTOCONFIG        1
+#endif
+
 #ifndef NDEBUG
 #define LWIP_DEBUG                  1
 #define LWIP_STATS                  1
@@ -0,0 +1,138 @@
+/*******************************************************************
+*
+* metrics.c
+*
+* Clock sync health metrics HTTP response rendering and caching
+*
+********************************************************************/
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "metrics.h"
+
+#define METRICS_BODY_MAX (METRICS_RESPONSE_MAX - 128)
+
+/******************************************************************
+*
+* metrics_render_response()
+*
+* render complete HTTP/1.0 response with metrics body into buf
+*
+* returns response length, -1 if buf is too small
+*
+*******************************************************************/
+int metrics_render_response( const clock_metrics_t *m, uint32_t renders, char *buf, int size )
+{
+    static char body[METRICS_BODY_MAX];
+    int body_len;
+    int header_len;
+
+    body_len = snprintf( body, sizeof(body),
+        "# TYPE ntp_clock_synced gauge\n"
+        "ntp_clock_synced %d\n"
+        "# TYPE ntp_clock_syncs_total counter\n"
+        "ntp_clock_syncs_total %u\n"
+        "# TYPE ntp_clock_last_sync_timestamp_seconds gauge\n"
+        "ntp_clock_last_sync_timestamp_seconds %u\n"
+        "# TYPE ntp_clock_offset_ms gauge\n"
+        "ntp_clock_offset_ms %d\n"
+        "# TYPE ntp_clock_delay_us gauge\n"
+        "ntp_clock_delay_us %u\n"
+        "# TYPE ntp_clock_stratum gauge\n"
+        "ntp_clock_stratum %u\n"
+        "# TYPE ntp_clock_server_info gauge\n"
+        "ntp_clock_server_info{server=\"%s\"} 1\n"
+        "# TYPE ntp_clock_drift_ppb gauge\n"
+        "ntp_clock_drift_ppb %d\n"
+        "# TYPE ntp_clock_drift_valid gauge\n"
+        "ntp_clock_drift_valid %d\n"
+        "# TYPE ntp_clock_wifi_rssi_dbm gauge\n"
+        "ntp_clock_wifi_rssi_dbm %d\n"
+        "# TYPE ntp_clock_lcd_frame_us gauge\n"
+        "ntp_clock_lcd_frame_us{stat=\"last\"} %u\n"
+        "ntp_clock_lcd_frame_us{stat=\"max\"} %u\n"
+        "# TYPE ntp_clock_metrics_renders_total counter\n"
+        "ntp_clock_metrics_renders_total %u\n",
+        m->synced, (unsigned int)m->sync_count, (unsigned int)m->last_sync_unix, (int)m->offset_ms,
+        (unsigned int)m->delay_us, m->stratum, m->server, (int)m->drift_ppb, m->drift_valid,
+        (int)m->wifi_rssi_dbm, (unsigned int)m->lcd_frame_us_last, (unsigned int)m->lcd_frame_us_max,
+        (unsigned int)renders );
+
+    if ( ( body_len < 0 ) || ( body_len >= (int)sizeof(body) ) )
+        return -1;
+
+    header_len = snprintf( buf, size,
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %d\r\n"
+        "Connection: close\r\n"
+        "\r\n", body_len );
+
+    if ( ( header_len < 0 ) || ( header_len + body_len > size ) )
+        return -1;
+
+    memcpy( buf + header_len, body, body_len );
+    return header_len + body_len;
+}
+
+/******************************************************************
+*
+* metrics_response_get()
+*
+* current rendered response, re-rendered if generation has changed
+* since the last render, m is a snapshot of the metrics at that
+* generation
+*
+* the response is in flight until metrics_response_release()
+*
+*******************************************************************/
+metrics_response_t *metrics_response_get( metrics_response_cache_t *cache, const clock_metrics_t *m, uint32_t generation )
+{
+    metrics_response_t *current = cache->current;
+    metrics_response_t *buf;
+
+    if ( current && ( current->generation == generation ) )
+    {
+        current->refs++;
+        return current;
+    }
+
+    // render into a buffer not referenced by an in-flight response
+    if ( ( current == NULL ) || ( current->refs == 0 ) )
+        buf = current ? current : &cache->buffers[0];
+    else
+        buf = ( current == &cache->buffers[0] ) ? &cache->buffers[1] : &cache->buffers[0];
+
+    if ( buf->refs )
+    {
+        cache->stale++;
+        current->refs++;
+        return current;
+    }
+
+    buf->len = metrics_render_response( m, ++cache->renders, buf->data, sizeof(buf->data) );
+    buf->generation = generation;
+    if ( buf->len < 0 )
+    {
+        printf("metrics response too large\n");
+        buf->len = 0;
+    }
+    buf->refs++;
+    cache->current = buf;
+    return buf;
+}
+
+/******************************************************************
+*
+* metrics_response_release()
+*
+* response from metrics_response_get() no longer in flight
+*
+*******************************************************************/
+void metrics_response_release( metrics_response_t *response )
+{
+    if ( response && ( response->refs > 0 ) )
+        response->refs--;
+}
@@ -0,0 +1,66 @@
+/*******************************************************************
+*
+* metrics.h
+*
+* Clock sync health metrics and HTTP plain text (Prometheus format)
+* response rendering and caching
+*
+* The response cache re-renders only when the metrics generation
+* has changed. It has two buffers so a new render never overwrites
+* a response still being sent, a buffer is in flight from
+* metrics_response_get() until metrics_response_release(). If both
+* buffers are in flight the previous render is served. The caller
+* does any locking.
+*
+* No hardware dependencies so the same rendering and caching is used
+* by the host load test in apps/
+*
+********************************************************************/
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// rendered HTTP response buffer size
+#define METRICS_RESPONSE_MAX   1536
+
+#define METRICS_SERVER_NAME_LEN 48
+
+typedef struct
+{
+    bool synced;                    // NTP time received since boot
+    uint32_t sync_count;
+    uint32_t last_sync_unix;        // UTC seconds of last sync
+    int32_t offset_ms;              // RTC - NTP time at last sync, 0 for the first
+    uint32_t delay_us;              // NTP round trip delay of last sync
+    uint8_t stratum;
+    char server[METRICS_SERVER_NAME_LEN];
+    bool drift_valid;
+    int32_t drift_ppb;              // RTC drift estimate from offset between syncs
+    int32_t wifi_rssi_dbm;
+    uint32_t lcd_frame_us_last;     // time to write both LCD lines
+    uint32_t lcd_frame_us_max;
+} clock_metrics_t;
+
+typedef struct
+{
+    char data[METRICS_RESPONSE_MAX];
+    int len;
+    int refs;                       // responses in flight from this buffer
+    uint32_t generation;            // metrics generation rendered
+} metrics_response_t;
+
+typedef struct
+{
+    metrics_response_t buffers[2];
+    metrics_response_t *current;    // NULL until first render
+    uint32_t renders;
+    uint32_t stale;                 // previous render served, both buffers in flight
+} metrics_response_cache_t;
+
+int metrics_render_response( const clock_metrics_t *m, uint32_t renders, char *buf, int size );
+metrics_response_t *metrics_response_get( metrics_response_cache_t *cache, const clock_metrics_t *m, uint32_t generation );
+void metrics_response_release( metrics_response_t *response );
+
+#endif // __METRICS_H__
@@ -0,0 +1,377 @@
+/*******************************************************************
+*
+* metrics_server.c
+*
+* Sync health metrics endpoint on the lwIP raw TCP API
+*
+* Metrics are updated from both cores and the lwIP callback context
+* under metrics_lock, each change bumps metrics_generation. A scrape
+* gets its response from the metrics.c response cache, which
+* re-renders only if the generation has changed. A response stays
+* in flight until lwIP has had it acknowledged, so tcp_write()
+* needs no copy.
+*
+********************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "pico/cyw43_arch.h"
+
+#include "lwip/tcp.h"
+
+#include "metrics.h"
+#include "metrics_server.h"
+
+#if METRICS_ENABLED
+
+#define METRICS_MAX_CONNECTIONS 4
+
+// tcp_poll() interval in 500ms units
+#define METRICS_POLL_INTERVAL 4
+
+// connections with nothing received or acknowledged for this many polls in a
+// row are aborted, long enough for a few retransmits on a weak Wi-Fi link
+#define METRICS_MAX_IDLE_POLLS 3
+
+// LCD frame time resolution, avoids re-rendering for microsecond jitter
+#define METRICS_LCD_FRAME_RES_US 100
+
+typedef struct
+{
+    struct tcp_pcb *pcb;
+    metrics_response_t *response;   // NULL until request received
+    int unacked;
+    int idle_polls;                 // polls since data last received or acknowledged
+} metrics_conn_t;
+
+static clock_metrics_t metrics;
+static uint32_t metrics_generation = 1;
+static critical_section_t metrics_lock;
+
+static metrics_response_cache_t response_cache;
+
+static metrics_conn_t conns[METRICS_MAX_CONNECTIONS];
+static struct tcp_pcb *listen_pcb = NULL;
+
+/******************************************************************
+*
+* get_response()
+*
+* response for a scrape, in flight until conn_release()
+*
+* response_cache is only used in lwIP context so needs no lock
+*
+*******************************************************************/
+static metrics_response_t *get_response( void )
+{
+    clock_metrics_t snapshot;
+    uint32_t generation;
+
+    critical_section_enter_blocking( &metrics_lock );
+    generation = metrics_generation;
+    snapshot = metrics;
+    critical_section_exit( &metrics_lock );
+
+    return metrics_response_get( &response_cache, &snapshot, generation );
+}
+
+/******************************************************************
+*
+* conn_release()
+*
+* free connection slot and response buffer reference
+*
+*******************************************************************/
+static void conn_release( metrics_conn_t *conn )
+{
+    metrics_response_release( conn->response );
+    conn->response = NULL;
+    conn->pcb = NULL;
+}
+
+/******************************************************************
+*
+* conn_close()
+*
+*******************************************************************/
+static err_t conn_close( metrics_conn_t *conn )
+{
+    struct tcp_pcb *pcb = conn->pcb;
+    err_t err = ERR_OK;
+
+    tcp_arg( pcb, NULL );
+    tcp_recv( pcb, NULL );
+    tcp_sent( pcb, NULL );
+    tcp_err( pcb, NULL );
+    tcp_poll( pcb, NULL, 0 );
+
+    if ( tcp_close( pcb ) != ERR_OK )
+    {
+        tcp_abort( pcb );
+        err = ERR_ABRT;
+    }
+    conn_release( conn );
+    return err;
+}
+
+/******************************************************************
+*
+* metrics_sent()
+*
+* tcp_sent() callback, close once whole response acknowledged
+*
+*******************************************************************/
+static err_t metrics_sent( void *arg, struct tcp_pcb *pcb, u16_t len )
+{
+    metrics_conn_t *conn = (metrics_conn_t *)arg;
+
+    conn->idle_polls = 0;
+    conn->unacked -= len;
+    if ( conn->unacked <= 0 )
+        return conn_close( conn );
+    return ERR_OK;
+}
+
+/******************************************************************
+*
+* metrics_recv()
+*
+* tcp_recv() callback, any request is answered with the metrics
+*
+*******************************************************************/
+static err_t metrics_recv( void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err )
+{
+    metrics_conn_t *conn = (metrics_conn_t *)arg;
+
+    if ( p == NULL )
+    {
+        // remote closed, keep the response buffer referenced until acknowledged
+        if ( conn->response && ( conn->unacked > 0 ) )
+            return ERR_OK;
+        return conn_close( conn );
+    }
+
+    tcp_recved( pcb, p->tot_len );
+    pbuf_free( p );
+    conn->idle_polls = 0;
+
+    if ( conn->response == NULL )
+    {
+        metrics_response_t *response = get_response();
+
+        conn->response = response;
+        conn->unacked = response->len;
+
+        // response buffer stays unchanged until acknowledged so no copy is needed
+        if ( tcp_write( pcb, response->data, response->len, 0 ) != ERR_OK )
+            return conn_close( conn );
+        tcp_output( pcb );
+    }
+    return ERR_OK;
+}
+
+/******************************************************************
+*
+* metrics_err()
+*
+* tcp_err() callback, pcb has already been freed
+*
+*******************************************************************/
+static void metrics_err( void *arg, err_t err )
+{
+    metrics_conn_t *conn = (metrics_conn_t *)arg;
+
+    if ( conn )
+        conn_release( conn );
+}
+
+/******************************************************************
+*
+* metrics_poll()
+*
+* tcp_poll() callback, abort connections making no progress
+*
+*******************************************************************/
+static err_t metrics_poll( void *arg, struct tcp_pcb *pcb )
+{
+    metrics_conn_t *conn = (metrics_conn_t *)arg;
+
+    if ( conn && ( ++conn->idle_polls < METRICS_MAX_IDLE_POLLS ) )
+        return ERR_OK;
+
+    tcp_arg( pcb, NULL );
+    tcp_abort( pcb );
+    if ( conn )
+        conn_release( conn );
+    return ERR_ABRT;
+}
+
+/******************************************************************
+*
+* metrics_accept()
+*
+* tcp_accept() callback
+*
+*******************************************************************/
+static err_t metrics_accept( void *arg, struct tcp_pcb *pcb, err_t err )
+{
+    metrics_conn_t *conn = NULL;
+    int i;
+
+    if ( ( err != ERR_OK ) || ( pcb == NULL ) )
+        return ERR_VAL;
+
+    for ( i = 0; i < METRICS_MAX_CONNECTIONS; i++ )
+    {
+        if ( conns[i].pcb == NULL )
+        {
+            conn = &conns[i];
+            break;
+        }
+    }
+    if ( conn == NULL )
+        return ERR_MEM;
+
+    conn->pcb = pcb;
+    conn->response = NULL;
+    conn->unacked = 0;
+    conn->idle_polls = 0;
+
+    tcp_arg( pcb, conn );
+    tcp_recv( pcb, metrics_recv );
+    tcp_sent( pcb, metrics_sent );
+    tcp_err( pcb, metrics_err );
+    tcp_poll( pcb, metrics_poll, METRICS_POLL_INTERVAL );
+    return ERR_OK;
+}
+
+/******************************************************************
+*
+* metrics_init()
+*
+* must be called before any metrics_set_xxx()
+*
+*******************************************************************/
+void metrics_init( void )
+{
+    critical_section_init( &metrics_lock );
+    strcpy( metrics.server, "none" );
+}
+
+/******************************************************************
+*
+* metrics_server_start()
+*
+* listen on METRICS_PORT, call once Wi-Fi is connected
+*
+*******************************************************************/
+int metrics_server_start( void )
+{
+    struct tcp_pcb *pcb;
+    int retval = 0;
+
+    if ( listen_pcb )
+        return 0;
+
+    cyw43_arch_lwip_begin();
+
+    pcb = tcp_new_ip_type( IPADDR_TYPE_ANY );
+    if ( pcb == NULL )
+    {
+        retval = -1;
+    }
+    else if ( tcp_bind( pcb, IP_ANY_TYPE, METRICS_PORT ) != ERR_OK )
+    {
+        tcp_close( pcb );
+        retval = -1;
+    }
+    else
+    {
+        listen_pcb = tcp_listen_with_backlog( pcb, METRICS_MAX_CONNECTIONS );
+        if ( listen_pcb == NULL )
+        {
+            tcp_close( pcb );
+            retval = -1;
+        }
+        else
+        {
+            tcp_accept( listen_pcb, metrics_accept );
+        }
+    }
+
+    cyw43_arch_lwip_end();
+
+    if ( retval )
+        printf("failed to start metrics server\n");
+    else
+        printf("metrics server on port %d\n", METRICS_PORT);
+
+    return retval;
+}
+
+/******************************************************************
+*
+* metrics_set_sync()
+*
+* record successful NTP sync
+*
+*******************************************************************/
+void metrics_set_sync( uint32_t unix_seconds, int32_t offset_ms, uint32_t delay_us, uint8_t stratum, const char *server, bool drift_valid, int32_t drift_ppb )
+{
+    critical_section_enter_blocking( &metrics_lock );
+    metrics.synced = true;
+    metrics.sync_count++;
+    metrics.last_sync_unix = unix_seconds;
+    metrics.offset_ms = offset_ms;
+    metrics.delay_us = delay_us;
+    metrics.stratum = stratum;
+    strncpy( metrics.server, server, METRICS_SERVER_NAME_LEN - 1 );
+    if ( drift_valid )
+    {
+        metrics.drift_valid = true;
+        metrics.drift_ppb = drift_ppb;
+    }
+    metrics_generation++;
+    critical_section_exit( &metrics_lock );
+}
+
+/******************************************************************
+*
+* metrics_set_wifi_rssi()
+*
+*******************************************************************/
+void metrics_set_wifi_rssi( int32_t rssi_dbm )
+{
+    critical_section_enter_blocking( &metrics_lock );
+    if ( metrics.wifi_rssi_dbm != rssi_dbm )
+    {
+        metrics.wifi_rssi_dbm = rssi_dbm;
+        metrics_generation++;
+    }
+    critical_section_exit( &metrics_lock );
+}
+
+/******************************************************************
+*
+* metrics_set_lcd_frame()
+*
+*******************************************************************/
+void metrics_set_lcd_frame( uint32_t frame_us )
+{
+    frame_us -= frame_us % METRICS_LCD_FRAME_RES_US;
+
+    critical_section_enter_blocking( &metrics_lock );
+    if ( metrics.lcd_frame_us_last != frame_us )
+    {
+        metrics.lcd_frame_us_last = frame_us;
+        if ( frame_us > metrics.lcd_frame_us_max )
+            metrics.lcd_frame_us_max = frame_us;
+        metrics_generation++;
+    }
+    critical_section_exit( &metrics_lock );
+}
+
+#endif // METRICS_ENABLED
@@ -0,0 +1,41 @@
+/*******************************************************************
+*
+* metrics_server.h
+*
+* Sync health metrics endpoint on the lwIP raw TCP API
+*
+* The HTTP response is rendered into a static buffer only when a
+* scrape arrives after a metric has changed, and is sent without
+* copying (tcp_write() without TCP_WRITE_FLAG_COPY)
+*
+********************************************************************/
+#ifndef __METRICS_SERVER_H__
+#define __METRICS_SERVER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 1
+#endif
+
+#ifndef METRICS_PORT
+#define METRICS_PORT 80
+#endif
+
+#if METRICS_ENABLED
+void metrics_init( void );
+int metrics_server_start( void );
+void metrics_set_sync( uint32_t unix_seconds, int32_t offset_ms, uint32_t delay_us, uint8_t stratum, const char *server, bool drift_valid, int32_t drift_ppb );
+void metrics_set_wifi_rssi( int32_t rssi_dbm );
+void metrics_set_lcd_frame( uint32_t frame_us );
+#else
+// values only computed for the metrics are evaluated to avoid unused warnings
+#define metrics_init()
+#define metrics_server_start()
+#define metrics_set_sync( unix_seconds, offset_ms, delay_us, stratum, server, drift_valid, drift_ppb ) ( (void)( drift_ppb ) )
+#define metrics_set_wifi_rssi( rssi_dbm )
+#define metrics_set_lcd_frame( frame_us ) ( (void)( frame_us ) )
+#endif
+
+#endif // __METRICS_SERVER_H__
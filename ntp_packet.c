@@ -0,0 +1,158 @@
+/*******************************************************************
+*
+* ntp_packet.c
+*
+* NTP client request/response packet handling
+*
+* NTPv4 specification: https://www.rfc-editor.org/rfc/rfc5905
+*
+********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ntp_packet.h"
+
+static const char *result_names[NTP_RESPONSE_NUM_RESULTS] = { "ok", "bad length", "bad mode", "bad stratum", "kiss-o'-death" };
+
+/******************************************************************
+*
+* get_be32()
+*
+* read network byte order unsigned long
+*
+*******************************************************************/
+static uint32_t get_be32( const uint8_t *buf )
+{
+    return (uint32_t)buf[0] << 24 |
+           (uint32_t)buf[1] << 16 |
+           (uint32_t)buf[2] << 8 |
+           (uint32_t)buf[3];
+}
+
+/******************************************************************
+*
+* is_kiss_code()
+*
+* Kiss-o'-Death reference id is four upper case ASCII characters
+*
+*******************************************************************/
+static bool is_kiss_code( const uint8_t *refid )
+{
+    int i;
+    for ( i = 0; i < 4; i++ )
+    {
+        if ( ( refid[i] < 'A' ) || ( refid[i] > 'Z' ) )
+            return false;
+    }
+    return true;
+}
+
+/******************************************************************
+*
+* ntp_build_request()
+*
+* fill NTP_MESSAGE_LEN byte buffer with client request
+*
+*******************************************************************/
+void ntp_build_request( uint8_t *req )
+{
+    memset(req, 0, NTP_MESSAGE_LEN);
+
+    // NTP request:  0x1B or 00 011 011 means
+    // LI   = 0    (Leap indicator)
+    // VN   = 3    (Version number)
+    // Mode = 3    (Mode, mode 3 is client mode)
+    req[0] = 0x1B;
+}
+
+/******************************************************************
+*
+* ntp_parse_response()
+*
+* validate received NTP message and decode into resp
+*
+* resp is filled in whenever len is valid so callers can report
+* the stratum/kiss code of rejected responses
+*
+*******************************************************************/
+ntp_response_result_t ntp_parse_response( const uint8_t *buf, uint16_t len, ntp_response_t *resp )
+{
+    if ( len != NTP_MESSAGE_LEN )
+        return NTP_RESPONSE_BAD_LENGTH;
+
+    resp->leap = buf[0] >> 6;
+    resp->version = ( buf[0] >> 3 ) & 0x7;
+    resp->mode = buf[0] & 0x7;
+    resp->stratum = buf[1];
+    resp->reference_id = get_be32( &buf[12] );
+
+    //NTP timestamps bytes 32-39 (receive) & 40-47 (transmit) network unsigned long format
+    resp->receive_seconds = get_be32( &buf[32] );
+    resp->receive_fraction = get_be32( &buf[36] );
+    resp->transmit_seconds = get_be32( &buf[40] );
+    resp->transmit_fraction = get_be32( &buf[44] );
+
+    // check mode = 0x4 (server) + stratum != 0 (valid)
+    if ( resp->mode != NTP_MODE_SERVER )
+        return NTP_RESPONSE_BAD_MODE;
+
+    if ( resp->stratum == 0 )
+        return is_kiss_code( &buf[12] ) ? NTP_RESPONSE_KISS_OF_DEATH : NTP_RESPONSE_BAD_STRATUM;
+
+    return NTP_RESPONSE_OK;
+}
+
+/******************************************************************
+*
+* ntp_to_unix_seconds()
+*
+* NTP epoch 1900 => Unix epoch 1970
+*
+*******************************************************************/
+uint32_t ntp_to_unix_seconds( uint32_t ntp_seconds )
+{
+    return ntp_seconds - NTP_EPOCH_OFFSET;
+}
+
+/******************************************************************
+*
+* ntp_fraction_to_us()
+*
+* NTP timestamp fraction (1/2^32 s) => microseconds
+*
+*******************************************************************/
+uint32_t ntp_fraction_to_us( uint32_t fraction )
+{
+    return (uint32_t)( ( (uint64_t)fraction * 1000000 ) >> 32 );
+}
+
+/******************************************************************
+*
+* ntp_round_trip_us()
+*
+* NTP round trip delay: client request to response time (local
+* monotonic clock) less server processing time (T3 - T2)
+*
+*******************************************************************/
+int64_t ntp_round_trip_us( uint64_t request_us, uint64_t response_us, const ntp_response_t *resp )
+{
+    int64_t server_us;
+
+    server_us = (int64_t)(int32_t)( resp->transmit_seconds - resp->receive_seconds ) * 1000000 +
+                (int64_t)ntp_fraction_to_us( resp->transmit_fraction ) - (int64_t)ntp_fraction_to_us( resp->receive_fraction );
+
+    return (int64_t)( response_us - request_us ) - server_us;
+}
+
+/******************************************************************
+*
+* ntp_response_result_str()
+*
+*******************************************************************/
+const char *ntp_response_result_str( ntp_response_result_t result )
+{
+    if ( result >= NTP_RESPONSE_NUM_RESULTS )
+        return "unknown";
+    return result_names[result];
+}
@@ -0,0 +1,61 @@
+/*******************************************************************
+*
+* ntp_packet.h
+*
+* NTP client request/response packet handling
+*
+* No PICO SDK or lwIP dependencies so the same validation logic
+* is used by the clock and by the host tools in apps/
+*
+********************************************************************/
+#ifndef __NTP_PACKET_H__
+#define __NTP_PACKET_H__
+
+#include <stdint.h>
+
+#define NTP_PORT 123
+#define NTP_MESSAGE_LEN 48
+
+// NTP uses an epoch of 1 January 1900. Unix uses an epoch of 1 January 1970.
+#define NTP_EPOCH_OFFSET 2208988800u
+
+// NTP association modes
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+
+// Leap indicator 3 = clock unsynchronised (used by Kiss-o'-Death packets)
+#define NTP_LEAP_UNSYNC 3
+
+// Result of ntp_parse_response()
+typedef enum
+{
+    NTP_RESPONSE_OK = 0,
+    NTP_RESPONSE_BAD_LENGTH,      // not a 48 byte NTP message
+    NTP_RESPONSE_BAD_MODE,        // mode != 4 (server)
+    NTP_RESPONSE_BAD_STRATUM,     // stratum 0 (unspecified/invalid)
+    NTP_RESPONSE_KISS_OF_DEATH,   // stratum 0 with ASCII kiss code in reference id
+    NTP_RESPONSE_NUM_RESULTS
+} ntp_response_result_t;
+
+// Decoded fields of a received NTP message
+typedef struct
+{
+    uint8_t leap;
+    uint8_t version;
+    uint8_t mode;
+    uint8_t stratum;
+    uint32_t reference_id;        // kiss code for Kiss-o'-Death packets
+    uint32_t receive_seconds;     // T2: server receive timestamp
+    uint32_t receive_fraction;
+    uint32_t transmit_seconds;    // T3: server transmit timestamp
+    uint32_t transmit_fraction;
+} ntp_response_t;
+
+void ntp_build_request( uint8_t *req );
+ntp_response_result_t ntp_parse_response( const uint8_t *buf, uint16_t len, ntp_response_t *resp );
+uint32_t ntp_to_unix_seconds( uint32_t ntp_seconds );
+uint32_t ntp_fraction_to_us( uint32_t fraction );
+int64_t ntp_round_trip_us( uint64_t request_us, uint64_t response_us, const ntp_response_t *resp );
+const char *ntp_response_result_str( ntp_response_result_t result );
+
+#endif // __NTP_PACKET_H__
@@ -0,0 +1,137 @@
+/*******************************************************************
+*
+* ntp_race.c
+*
+* Race NTP requests to several candidate servers
+*
+********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ntp_packet.h"
+#include "ntp_race.h"
+
+/******************************************************************
+*
+* ntp_race_start()
+*
+*******************************************************************/
+void ntp_race_start( ntp_race_t *race, uint64_t now_us, uint32_t good_delay_us, uint32_t grace_us, uint32_t timeout_us )
+{
+    memset( race, 0, sizeof(*race) );
+    race->state = NTP_RACE_RUNNING;
+    race->good_delay_us = good_delay_us;
+    race->grace_us = grace_us;
+    race->timeout_us = timeout_us;
+    race->start_us = now_us;
+    race->best = -1;
+}
+
+/******************************************************************
+*
+* ntp_race_add()
+*
+* add candidate, request_us is the time its request is sent
+*
+* returns candidate index, -1 if the race is over or full
+*
+*******************************************************************/
+int ntp_race_add( ntp_race_t *race, uint64_t request_us )
+{
+    ntp_race_candidate_t *c;
+
+    if ( ( race->state != NTP_RACE_RUNNING ) || ( race->num_candidates >= NTP_RACE_MAX_CANDIDATES ) )
+        return -1;
+
+    c = &race->candidates[race->num_candidates];
+    c->request_us = request_us;
+    c->responded = false;
+    c->valid = false;
+    return race->num_candidates++;
+}
+
+/******************************************************************
+*
+* ntp_race_response()
+*
+* validate first datagram from candidate, keep lowest delay valid
+* reply, result set to ntp_parse_response() result
+*
+*******************************************************************/
+ntp_race_state_t ntp_race_response( ntp_race_t *race, int candidate, const uint8_t *buf, uint16_t len, uint64_t now_us, ntp_response_result_t *result )
+{
+    ntp_race_candidate_t *c;
+    ntp_response_t resp;
+    int64_t delay_us;
+
+    *result = NTP_RESPONSE_BAD_LENGTH;
+
+    if ( ( race->state != NTP_RACE_RUNNING ) || ( candidate < 0 ) || ( candidate >= race->num_candidates ) )
+        return race->state;
+
+    c = &race->candidates[candidate];
+    if ( c->responded )
+        return race->state;
+    c->responded = true;
+
+    *result = ntp_parse_response( buf, len, &resp );
+    if ( *result != NTP_RESPONSE_OK )
+        return race->state;
+
+    c->valid = true;
+    delay_us = ntp_round_trip_us( c->request_us, now_us, &resp );
+    if ( delay_us < 0 )
+        delay_us = 0;
+
+    if ( race->best < 0 )
+        race->first_valid_us = now_us;
+
+    if ( ( race->best < 0 ) || ( delay_us < race->best_delay_us ) )
+    {
+        race->best = candidate;
+        race->best_resp = resp;
+        race->best_delay_us = delay_us;
+        race->best_response_us = now_us;
+    }
+
+    if ( delay_us <= race->good_delay_us )
+        race->state = NTP_RACE_DONE;
+
+    return race->state;
+}
+
+/******************************************************************
+*
+* ntp_race_poll()
+*
+* end the race on grace/overall timeout, or once every candidate
+* has responded and more_candidates is false
+*
+*******************************************************************/
+ntp_race_state_t ntp_race_poll( ntp_race_t *race, uint64_t now_us, bool more_candidates )
+{
+    bool all_responded = !more_candidates;
+    int i;
+
+    if ( race->state != NTP_RACE_RUNNING )
+        return race->state;
+
+    for ( i = 0; i < race->num_candidates; i++ )
+    {
+        if ( !race->candidates[i].responded )
+            all_responded = false;
+    }
+
+    if ( race->best >= 0 )
+    {
+        if ( all_responded || ( now_us - race->first_valid_us >= race->grace_us ) || ( now_us - race->start_us >= race->timeout_us ) )
+            race->state = NTP_RACE_DONE;
+    }
+    else if ( all_responded || ( now_us - race->start_us >= race->timeout_us ) )
+    {
+        race->state = NTP_RACE_FAILED;
+    }
+
+    return race->state;
+}
@@ -0,0 +1,71 @@
+/*******************************************************************
+*
+* ntp_race.h
+*
+* Race NTP requests to several candidate servers and select the
+* reply to sync from
+*
+* A request is sent to each candidate as soon as its address is
+* known. The first valid reply with a round trip delay of at most
+* good_delay_us wins at once, otherwise the lowest delay valid reply
+* received within grace_us of the first valid reply is used.
+*
+* No PICO SDK or lwIP dependencies so the same selection logic is
+* used by the clock and by apps/ntp_sync_bench
+*
+********************************************************************/
+#ifndef __NTP_RACE_H__
+#define __NTP_RACE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ntp_packet.h"
+
+#define NTP_RACE_MAX_CANDIDATES 8
+
+// the clock's race settings, also used by apps/ntp_sync_bench
+#define NTP_RACE_GOOD_DELAY_MS  50
+#define NTP_RACE_GRACE_MS       250
+#define NTP_RACE_TIMEOUT_MS     10000
+
+// the clock starts another race this long after a failed one while
+// running on provisional time
+#define NTP_UNSYNCED_RETRY_S    60
+
+typedef enum
+{
+    NTP_RACE_RUNNING = 0,
+    NTP_RACE_DONE,              // best holds the reply to sync from
+    NTP_RACE_FAILED             // timed out or no candidates left
+} ntp_race_state_t;
+
+typedef struct
+{
+    uint64_t request_us;        // local monotonic time request sent
+    bool responded;             // first datagram received, later ones ignored
+    bool valid;
+} ntp_race_candidate_t;
+
+typedef struct
+{
+    ntp_race_state_t state;
+    uint32_t good_delay_us;
+    uint32_t grace_us;
+    uint32_t timeout_us;        // from ntp_race_start()
+    uint64_t start_us;
+    uint64_t first_valid_us;
+    int num_candidates;
+    ntp_race_candidate_t candidates[NTP_RACE_MAX_CANDIDATES];
+    int best;                   // candidate index, -1 = no valid reply
+    ntp_response_t best_resp;
+    int64_t best_delay_us;
+    uint64_t best_response_us;  // local monotonic time best reply received
+} ntp_race_t;
+
+void ntp_race_start( ntp_race_t *race, uint64_t now_us, uint32_t good_delay_us, uint32_t grace_us, uint32_t timeout_us );
+int ntp_race_add( ntp_race_t *race, uint64_t request_us );
+ntp_race_state_t ntp_race_response( ntp_race_t *race, int candidate, const uint8_t *buf, uint16_t len, uint64_t now_us, ntp_response_result_t *result );
+ntp_race_state_t ntp_race_poll( ntp_race_t *race, uint64_t now_us, bool more_candidates );
+
+#endif // __NTP_RACE_H__
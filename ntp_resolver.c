@@ -0,0 +1,191 @@
+/*******************************************************************
+*
+* ntp_resolver.c
+*
+* Concurrent DNS lookup of the configured NTP server list with an
+* address cache
+*
+* found() is called in lwIP context, from ntp_resolver_resolve()
+* for cached addresses and from the DNS callback for lookups
+*
+********************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+
+#include "lwip/dns.h"
+
+#include "ntp_resolver.h"
+#include "trace.h"
+
+typedef struct
+{
+    ip_addr_t addr;
+    uint64_t expires_us;
+    bool valid;
+    bool pending;               // lookup in progress
+} ntp_resolver_entry_t;
+
+static const char *servers[] = { NTP_SERVER_LIST };
+
+#define NUM_SERVERS ( sizeof(servers) / sizeof(servers[0]) < NTP_RESOLVER_MAX_SERVERS ? \
+                      sizeof(servers) / sizeof(servers[0]) : NTP_RESOLVER_MAX_SERVERS )
+
+static ntp_resolver_entry_t entries[NTP_RESOLVER_MAX_SERVERS];
+static ntp_resolver_found_fn found_fn = NULL;
+
+/******************************************************************
+*
+* ntp_resolver_num_servers()
+*
+*******************************************************************/
+int ntp_resolver_num_servers( void )
+{
+    return NUM_SERVERS;
+}
+
+/******************************************************************
+*
+* ntp_resolver_server_name()
+*
+*******************************************************************/
+const char *ntp_resolver_server_name( int server )
+{
+    return ( server >= 0 ) && ( server < (int)NUM_SERVERS ) ? servers[server] : "";
+}
+
+/******************************************************************
+*
+* dns_found()
+*
+* callback for dns_gethostbyname()
+*
+*******************************************************************/
+static void dns_found( const char *hostname, const ip_addr_t *ipaddr, void *arg )
+{
+    int server = (int)(uintptr_t)arg;
+    ntp_resolver_entry_t *e = &entries[server];
+
+    e->pending = false;
+    if ( ipaddr )
+    {
+        e->addr = *ipaddr;
+        e->expires_us = time_us_64() + NTP_DNS_CACHE_TTL_S * 1000000ull;
+        e->valid = true;
+    }
+
+    if ( found_fn )
+    {
+        found_fn( server, ipaddr );
+    }
+}
+
+/******************************************************************
+*
+* ntp_resolver_resolve()
+*
+* look up every server not cached or being looked up, lookups run
+* concurrently
+*
+* returns number of servers with a cached address or lookup
+* in progress
+*
+*******************************************************************/
+int ntp_resolver_resolve( ntp_resolver_found_fn found )
+{
+    uint64_t now_us = time_us_64();
+    int count = 0;
+    int i;
+
+    cyw43_arch_lwip_begin();
+
+    found_fn = found;
+
+    for ( i = 0; i < (int)NUM_SERVERS; i++ )
+    {
+        ntp_resolver_entry_t *e = &entries[i];
+        ip_addr_t addr;
+        err_t err;
+
+        if ( e->pending )
+        {
+            count++;
+            continue;
+        }
+
+        if ( e->valid && ( (int64_t)( e->expires_us - now_us ) > 0 ) )
+        {
+            count++;
+            found( i, &e->addr );
+            continue;
+        }
+        e->valid = false;
+
+#if LWIP_IPV6
+        err = dns_gethostbyname_addrtype( servers[i], &addr, dns_found, (void *)(uintptr_t)i,
+                                          ( i & 1 ) ? LWIP_DNS_ADDRTYPE_IPV4_IPV6 : LWIP_DNS_ADDRTYPE_IPV6_IPV4 );
+#else
+        err = dns_gethostbyname( servers[i], &addr, dns_found, (void *)(uintptr_t)i );
+#endif
+        trace_record( TRACE_EVENT_DNS_SENT, &(int8_t){ err }, 1 );
+
+        if ( err == ERR_OK )
+        {
+            // lwIP cache hit or numeric address
+            dns_found( servers[i], &addr, (void *)(uintptr_t)i );
+            count++;
+        }
+        else if ( err == ERR_INPROGRESS )
+        {
+            e->pending = true;
+            count++;
+        }
+        else
+        {
+            found( i, NULL );
+        }
+    }
+
+    cyw43_arch_lwip_end();
+
+    return count;
+}
+
+/******************************************************************
+*
+* ntp_resolver_pending()
+*
+* number of lookups in progress
+*
+*******************************************************************/
+int ntp_resolver_pending( void )
+{
+    int count = 0;
+    int i;
+
+    for ( i = 0; i < (int)NUM_SERVERS; i++ )
+    {
+        if ( entries[i].pending )
+            count++;
+    }
+    return count;
+}
+
+/******************************************************************
+*
+* ntp_resolver_invalidate()
+*
+* drop cached address, e.g. server sent an invalid reply, so the next
+* ntp_resolver_resolve() looks it up again
+*
+*******************************************************************/
+void ntp_resolver_invalidate( int server )
+{
+    if ( ( server >= 0 ) && ( server < (int)NUM_SERVERS ) )
+    {
+        entries[server].valid = false;
+    }
+}
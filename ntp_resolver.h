@@ -0,0 +1,49 @@
+/*******************************************************************
+*
+* ntp_resolver.h
+*
+* Concurrent DNS lookup of the configured NTP server list with an
+* address cache
+*
+* lwIP returns one address per lookup, so each server name gives
+* one candidate; the pool.ntp.org numbered names (0..3) each return
+* a different round-robin server. With LWIP_IPV6 even numbered
+* servers prefer AAAA records and odd numbered servers A records,
+* so both address families take part in the race.
+*
+* lwIP does not pass the DNS TTL to the application (its own cache
+* does use it, and pool.ntp.org TTLs are minutes), so addresses are
+* cached for NTP_DNS_CACHE_TTL_S. This is longer than the daily
+* resync so a server is kept while it answers, as ntpd keeps pool
+* servers; the clock drops an address after an invalid reply or a
+* race with no valid reply.
+*
+********************************************************************/
+#ifndef __NTP_RESOLVER_H__
+#define __NTP_RESOLVER_H__
+
+#include <stdint.h>
+
+#include "lwip/ip_addr.h"
+
+// NTP server host names or addresses, set by NTP_SERVERS in CMakeLists.txt
+#ifndef NTP_SERVER_LIST
+#define NTP_SERVER_LIST "0.uk.pool.ntp.org", "1.uk.pool.ntp.org", "2.uk.pool.ntp.org", "3.uk.pool.ntp.org"
+#endif
+
+#define NTP_RESOLVER_MAX_SERVERS 8
+
+#ifndef NTP_DNS_CACHE_TTL_S
+#define NTP_DNS_CACHE_TTL_S (25 * 60 * 60)
+#endif
+
+// called with addr NULL if the lookup failed
+typedef void (*ntp_resolver_found_fn)( int server, const ip_addr_t *addr );
+
+int ntp_resolver_num_servers( void );
+const char *ntp_resolver_server_name( int server );
+int ntp_resolver_resolve( ntp_resolver_found_fn found );
+int ntp_resolver_pending( void );
+void ntp_resolver_invalidate( int server );
+
+#endif // __NTP_RESOLVER_H__
@@ -6,6 +6,9 @@
 *
 * Uses HD44780 16x2 LCD with I2C interface
 *
+* Core 0 runs Wi-Fi/NTP, core 1 runs the LCD so the display starts
+* with a provisional time while Wi-Fi connects and NTP is requested
+*
 * NTPv4 specification: https://www.rfc-editor.org/rfc/rfc5905
 *
 ********************************************************************/
@@ -17,112 +20,236 @@
 #include "pico/stdlib.h"
 #include "pico/util/datetime.h"
 #include "pico/cyw43_arch.h"
+#include "pico/multicore.h"
 
 #include "hardware/rtc.h"
 #include "hardware/i2c.h"
+#include "hardware/watchdog.h"
 
-#include "lwip/dns.h"
 #include "lwip/pbuf.h"
 #include "lwip/udp.h"
 
 #include "hd44780_lcd_api.h"
+#include "ntp_packet.h"
+#include "ntp_race.h"
+#include "ntp_resolver.h"
+#include "clock_time.h"
+#include "trace.h"
+#include "boot_phase.h"
+#include "metrics_server.h"
+#include "tlog.h"
+#include "tlog_fmt.h"
+
+// watchdog scratch registers holding last known time, survive soft reset
+#define LAST_TIME_MAGIC        0x4E545043
+#define LAST_TIME_SCRATCH_MAGIC 0
+#define LAST_TIME_SCRATCH_DATE  1
+#define LAST_TIME_SCRATCH_TIME  2
+
+// Wi-Fi RSSI metric sample interval
+#define RSSI_SAMPLE_S 10
+
+// UART console keys to dump the event trace & run the log benchmark
+#define TRACE_DUMP_KEY 't'
+#define TLOG_BENCH_KEY 'b'
+
+static ntp_race_t race;
+static ip_addr_t candidate_address[NTP_RACE_MAX_CANDIDATES];
+static int candidate_server[NTP_RACE_MAX_CANDIDATES];      // ntp_resolver server index
 
-#include "bsttimes.h"
-
-#define NTP_SERVER_ADDR "uk.pool.ntp.org"
-#define NTP_PORT 123
-#define NTP_MESSAGE_LEN 48
+static struct udp_pcb *udp_pcb = NULL; //UDP protocol control block
 
-// British Summer Time 1 hour offset
-#define BST_OFFSET (60 * 60) 
+static int current_day = 0;
+static volatile bool is_dst = false;
+static volatile bool ntp_synced = false;
 
-// NTP uses an epoch of 1 January 1900. Unix uses an epoch of 1 January 1970. 
-#define NTP_EPOCH_OFFSET 2208988800
+static uint64_t last_sync_us = 0;       // time_us_64() of last NTP sync
+static int64_t last_set_error_ms = 0;   // RTC - NTP time when the RTC was last set
 
-static char *dayofweek[7] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
-static char *months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
-static char *timezone[2] = { "GMT", "BST" };
+/******************************************************************
+*
+* console_service()
+*
+* dump event trace when TRACE_DUMP_KEY received on UART console,
+* run log benchmark on TLOG_BENCH_KEY, send pending log records
+*
+*******************************************************************/
+static void console_service( void )
+{
+    int c = getchar_timeout_us( 0 );
 
-static ip_addr_t ntp_server_address;
-static bool dns_request_sent;
+    if ( c == TRACE_DUMP_KEY )
+    {
+        trace_dump();
+    }
+    else if ( c == TLOG_BENCH_KEY )
+    {
+        tlog_benchmark();
+    }
 
-static struct udp_pcb *udp_pcb = NULL; //UDP protocol control block
+    tlog_drain();
+}
 
-static int current_day = 0;
-static bool is_dst = false;
+/******************************************************************
+*
+* trace_rtc_read()
+*
+*******************************************************************/
+static void trace_rtc_read( const datetime_t *t )
+{
+    trace_datetime_t td;
+
+    td.year = t->year;
+    td.month = t->month;
+    td.day = t->day;
+    td.dotw = t->dotw;
+    td.hour = t->hour;
+    td.min = t->min;
+    td.sec = t->sec;
+    trace_record( TRACE_EVENT_RTC_READ, &td, sizeof(td) );
+}
 
 /******************************************************************
 *
-* dst_check()
+* lcd_show_line()
 *
-* BST is last Sunday in March to last Sunday in October
+* write line to LCD row and record LCD frame event
 *
-* check current time is within bst_start_times & bst_end_times for BST
+*******************************************************************/
+static void lcd_show_line( int row, const char *line )
+{
+    struct
+    {
+        uint8_t row;
+        char text[HD44780_MAX_CHARS];
+    } __attribute__((packed)) frame;
+    int len = strnlen( line, HD44780_MAX_CHARS );
+
+    hd44780_lcd_set_cursor( row, 0 );
+    hd44780_lcd_string( line );
+
+    frame.row = row;
+    memcpy( frame.text, line, len );
+    trace_record( TRACE_EVENT_LCD_FRAME, &frame, 1 + len );
+}
+
+/******************************************************************
 *
+* trace_ip4_addr()
+*
+* trace records hold IPv4 addresses, IPv6 is recorded as 0
 *
 *******************************************************************/
-static bool dst_check( const time_t unix_format_time, const int year )
+static uint32_t trace_ip4_addr( const ip_addr_t *ipaddr )
 {
-    bool bst;   
-    if ( (unix_format_time > bst_start_times[year-BST_START_YEAR] ) && (unix_format_time < bst_end_times[year-BST_START_YEAR] ) )
-        bst = true;
-    else
-        bst = false;             
+    return ( ipaddr && IP_IS_V4( ipaddr ) ) ? ip4_addr_get_u32( ip_2_ip4( ipaddr ) ) : 0;
+}
 
-   return bst;
+/******************************************************************
+*
+* trace_dns_result()
+*
+*******************************************************************/
+static void trace_dns_result( const ip_addr_t *ipaddr )
+{
+    uint32_t addr = trace_ip4_addr( ipaddr );
+    trace_record( TRACE_EVENT_DNS_RESULT, &addr, sizeof(addr) );
 }
+
 /******************************************************************
 *
 * ntp_request()
 *
-* send UDP NTP request message
+* add server address to the race and send UDP NTP request message
 *
 *******************************************************************/
-static void ntp_request( void ) 
+static void ntp_request( int server, const ip_addr_t *ipaddr ) 
 {
     struct pbuf *pbuf;
     uint8_t *req;
+    int candidate;
+    int i;
+    struct
+    {
+        trace_ntp_tx_t tx;
+        uint8_t data[NTP_MESSAGE_LEN];
+    } __attribute__((packed)) trace_tx;
 
     cyw43_arch_lwip_begin();
 
+    // several server names can resolve to the same pool server
+    for ( i = 0; i < race.num_candidates; i++ )
+    {
+        if ( ip_addr_cmp( ipaddr, &candidate_address[i] ) )
+        {
+            cyw43_arch_lwip_end();
+            return;
+        }
+    }
+
     pbuf = pbuf_alloc(PBUF_TRANSPORT, NTP_MESSAGE_LEN, PBUF_RAM);
+    if ( pbuf )
+    {
+        req = (uint8_t *) pbuf->payload;
 
-    req = (uint8_t *) pbuf->payload;
+        ntp_build_request( req );
 
-    memset(req, 0, NTP_MESSAGE_LEN);
-    
-    // NTP request:  0x1B or 00 011 011 means
-    // LI   = 0    (Leap indicator)
-    // VN   = 3    (Version number)
-    // Mode = 3    (Mode, mode 3 is client mode)
-    req[0] = 0x1B;
-    
-    udp_sendto( udp_pcb, pbuf, &ntp_server_address, NTP_PORT );
+        candidate = ntp_race_add( &race, time_us_64() );
+        if ( candidate >= 0 )
+        {
+            candidate_address[candidate] = *ipaddr;
+            candidate_server[candidate] = server;
 
-    pbuf_free( pbuf );
+            trace_tx.tx.addr = trace_ip4_addr( ipaddr );
+            trace_tx.tx.server = server;
+            trace_tx.tx.candidate = candidate;
+            memcpy( trace_tx.data, req, NTP_MESSAGE_LEN );
+            trace_record( TRACE_EVENT_NTP_TX, &trace_tx, sizeof(trace_tx) );
+
+            udp_sendto( udp_pcb, pbuf, ipaddr, NTP_PORT );
+        }
+
+        pbuf_free( pbuf );
+    }
 
     cyw43_arch_lwip_end();
 }
 
 /******************************************************************
 *
-* ntp_dns_found()
+* ntp_server_found()
 *
-* callback for dns_gethostbyname()
+* ntp_resolver_resolve() callback, request NTP time from server
+* as soon as its address is known
 *
 *******************************************************************/
-static void ntp_dns_found(const char *hostname, const ip_addr_t *ipaddr, void *arg) 
+static void ntp_server_found( int server, const ip_addr_t *ipaddr ) 
 {   
-    if (ipaddr) 
+    trace_dns_result( ipaddr );
+
+    if ( ipaddr == NULL ) 
     {
-        ntp_server_address = *ipaddr;
-        printf("found ntp address %s\n", ipaddr_ntoa(ipaddr));
-        ntp_request();
-    } 
-    else 
+        tlog( TLOG_FMT_DNS_FAILED, server);
+    }
+    else
     {
-        printf("ntp dns request failed\n");
-        dns_request_sent = false;
+        boot_phase_mark( BOOT_PHASE_DNS_RESOLVED );
+
+        if ( IP_IS_V4( ipaddr ) )
+        {
+            tlog( TLOG_FMT_DNS_FOUND,
+                 (unsigned int)ip4_addr1( ip_2_ip4( ipaddr ) ), (unsigned int)ip4_addr2( ip_2_ip4( ipaddr ) ),
+                 (unsigned int)ip4_addr3( ip_2_ip4( ipaddr ) ), (unsigned int)ip4_addr4( ip_2_ip4( ipaddr ) ), server);
+        }
+        else
+        {
+            tlog( TLOG_FMT_DNS_FOUND_IPV6, server);
+        }
+
+        if ( ( udp_pcb != NULL ) && ( race.state == NTP_RACE_RUNNING ) )
+        {
+            ntp_request( server, ipaddr );
+        }
     }
 }
 
@@ -132,84 +259,175 @@ static void ntp_dns_found(const char *hostname, const ip_addr_t *ipaddr, void *a
 * ntp_receive()
 *
 * Callback for udp_recv() with NTP data received
-* update RTC with received NTP time
+* pass response from a candidate server to the race
 *
 *******************************************************************/
 static void ntp_receive(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) 
 {
-    if ( ip_addr_cmp( addr, &ntp_server_address ) && ( port == NTP_PORT ) && ( p->tot_len == NTP_MESSAGE_LEN ) ) 
+    uint8_t buf[NTP_MESSAGE_LEN];
+    ntp_response_result_t result = NTP_RESPONSE_BAD_LENGTH;
+    int candidate = -1;
+    int i;
+    struct
     {
-        uint8_t mode;
-        uint8_t stratum;
+        trace_ntp_rx_t rx;
+        uint8_t data[NTP_MESSAGE_LEN];
+    } __attribute__((packed)) trace_rx;
 
-        mode = pbuf_get_at( p, 0 ) & 0x7;
-        stratum = pbuf_get_at( p, 1 ); 
-        // check mode = 0x4 (server) + stratum != 0 (valid)        
-        if ( ( mode == 0x4 ) && ( stratum != 0 ) )
-        {
-            uint32_t ntp_seconds;
-            uint32_t unix_seconds;
-            time_t unix_epoch;
-            datetime_t t;
-            struct tm *ntp_tm;
-
-            //NTP timestamp bytes 40-44 network unsigned long format
-            ntp_seconds = pbuf_get_at( p, 40 ) << 24 | 
-                          pbuf_get_at( p, 41 ) << 16 | 
-                          pbuf_get_at( p, 42 ) << 8 | 
-                          pbuf_get_at( p, 43 );
-                          
-            //NTP epoch 1900 => Unix epoch 1970
-            unix_seconds = ntp_seconds - NTP_EPOCH_OFFSET;
-            unix_epoch = unix_seconds;
-        
-            ntp_tm = gmtime( &unix_epoch );
+    trace_rx.rx.addr = trace_ip4_addr( addr );
+    trace_rx.rx.port = port;
+    trace_rx.rx.tot_len = p->tot_len;
+    trace_record( TRACE_EVENT_NTP_RX, &trace_rx, sizeof(trace_ntp_rx_t) + pbuf_copy_partial( p, trace_rx.data, NTP_MESSAGE_LEN, 0 ) );
 
-            is_dst = dst_check( unix_epoch, 1900+ntp_tm->tm_year);
-            if ( is_dst )
-            {
-                unix_epoch += BST_OFFSET;
-                ntp_tm = gmtime( &unix_epoch );
-            }
+    for ( i = 0; ( i < race.num_candidates ) && ( port == NTP_PORT ); i++ )
+    {
+        if ( ip_addr_cmp( addr, &candidate_address[i] ) )
+        {
+            candidate = i;
+        }
+    }
 
-            printf("NTP RX: %s\n", asctime(ntp_tm) );
+    if ( candidate < 0 )
+    {
+        tlog( TLOG_FMT_NTP_UNKNOWN_SOURCE);
+    }
+    else if ( race.state != NTP_RACE_RUNNING )
+    {
+        tlog( TLOG_FMT_NTP_LATE, candidate_server[candidate]);
+    }
+    else
+    {
+        pbuf_copy_partial( p, buf, NTP_MESSAGE_LEN, 0 );
+        ntp_race_response( &race, candidate, buf, p->tot_len, time_us_64(), &result );
 
-            tm_to_datetime( ntp_tm, &t );
-    
-            rtc_set_datetime( &t );
+        if ( result == NTP_RESPONSE_OK )
+        {
+            tlog( TLOG_FMT_NTP_OK, candidate_server[candidate]);
+        }
+        else
+        {
+            // result is ntp_response_result_t, see ntp_packet.h
+            tlog( TLOG_FMT_NTP_REJECTED, candidate_server[candidate], result);
         }
-    } 
-    else 
-    {
-        printf("invalid ntp response\n");
     }
 
-    dns_request_sent = false;
     pbuf_free(p);
 }
 
+/******************************************************************
+*
+* ntp_sync()
+*
+* update RTC with time from the race winner
+*
+*******************************************************************/
+static void ntp_sync( void )
+{
+    const ntp_response_t *resp = &race.best_resp;
+    datetime_t t;
+    datetime_t rtc_now;
+    uint64_t now_us = time_us_64();
+    uint32_t unix_seconds = ntp_to_unix_seconds( resp->transmit_seconds );
+    int64_t rtc_unix_seconds;
+    int64_t correction_ms;
+    uint32_t correction_s;
+    int64_t offset_ms;
+    int64_t drift;
+    int32_t sync_offset_ms = 0;
+    int32_t drift_ppb = 0;
+    trace_ntp_sync_t trace_sync;
+    bool dst;
+
+    // RTC holds local time, remove BST to compare with NTP (UTC)
+    rtc_get_datetime( &rtc_now );
+    rtc_unix_seconds = clock_datetime_to_seconds( &rtc_now ) - ( is_dst ? BST_OFFSET : 0 );
+
+    // NTP time now is transmit timestamp + half round trip + time since receipt
+    correction_ms = ( ntp_fraction_to_us( resp->transmit_fraction ) + race.best_delay_us / 2 + ( now_us - race.best_response_us ) ) / 1000;
+    offset_ms = ( rtc_unix_seconds - unix_seconds ) * 1000 - correction_ms;
+
+    // before the first sync the RTC holds provisional time which can be
+    // weeks out, so the offset is only reported against a synced RTC;
+    // drift excludes the known error the RTC was last set with
+    if ( ntp_synced )
+    {
+        sync_offset_ms = offset_ms > INT32_MAX ? INT32_MAX : offset_ms < INT32_MIN ? INT32_MIN : (int32_t)offset_ms;
+        drift = ( offset_ms - last_set_error_ms ) * 1000000000 / (int64_t)( ( now_us - last_sync_us ) / 1000 + 1 );
+        drift_ppb = drift > INT32_MAX ? INT32_MAX : drift < INT32_MIN ? INT32_MIN : (int32_t)drift;
+    }
+
+    // the RTC holds whole seconds, set it to NTP time now rounded to the
+    // nearest second rather than the second the reply was sent in
+    correction_s = (uint32_t)( ( correction_ms + 500 ) / 1000 );
+    dst = clock_ntp_to_datetime( resp->transmit_seconds + correction_s, &t );
+
+    tlog( TLOG_FMT_NTP_SYNC,
+         t.year, t.month, t.day, t.hour, t.min, t.sec, (int)sync_offset_ms, (int)race.best_delay_us );
+    tlog( TLOG_FMT_NTP_SELECTED, candidate_server[race.best], race.num_candidates);
+
+    metrics_set_sync( unix_seconds, sync_offset_ms, race.best_delay_us, resp->stratum, ipaddr_ntoa( &candidate_address[race.best] ), ntp_synced, drift_ppb );
+    last_sync_us = now_us;
+
+    // set the RTC before publishing the zone so core 1 never shows or
+    // saves the new zone against the old time
+    rtc_set_datetime( &t );
+    is_dst = dst;
+    ntp_synced = true;
+
+    // RTC set to the nearest second, within 500ms of NTP time
+    last_set_error_ms = (int64_t)correction_s * 1000 - correction_ms;
+
+    trace_sync.transmit_seconds = resp->transmit_seconds;
+    trace_sync.transmit_fraction = resp->transmit_fraction;
+    trace_sync.delay_us = race.best_delay_us;
+    trace_sync.correction_ms = (uint16_t)correction_ms;
+    trace_sync.server = candidate_server[race.best];
+    trace_sync.candidates = race.num_candidates;
+    trace_record( TRACE_EVENT_NTP_SYNC, &trace_sync, sizeof(trace_sync) );
+
+    boot_phase_mark( BOOT_PHASE_NTP_SYNCED );
+}
+
 /******************************************************************
 *
 * ntp_get_time()
 *
 * Connect to Wi-Fi SSID
-* Request NTP time from NTP server
+* Request NTP time from every configured NTP server, sync from
+* the first low delay reply
 *
 *******************************************************************/
 static int ntp_get_time( void )
 {
     int retval=0;
     
-    cyw43_arch_enable_sta_mode();
+    int8_t wifi_status[2] = { 0, 0 };
+    
+    /* metrics server keeps Wi-Fi connected between NTP requests */
+    if ( cyw43_tcpip_link_status( &cyw43_state, CYW43_ITF_STA ) != CYW43_LINK_UP )
+    {
+        cyw43_arch_enable_sta_mode();
+
+        wifi_status[0] = cyw43_arch_wifi_connect_timeout_ms(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK, 10000);
+    }
+    wifi_status[1] = cyw43_tcpip_link_status( &cyw43_state, CYW43_ITF_STA );
+    trace_record( TRACE_EVENT_WIFI_STATUS, wifi_status, sizeof(wifi_status) );
 
-    if (cyw43_arch_wifi_connect_timeout_ms(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK, 10000)) 
+    if ( wifi_status[0] ) 
     {
         printf("failed to connect to %s\n", WIFI_SSID);
         retval = -1;
     }
     else
     {
+        boot_phase_mark( BOOT_PHASE_WIFI_CONNECTED );
+
+        metrics_server_start();
+
+        cyw43_arch_lwip_begin();
         udp_pcb = udp_new_ip_type( IPADDR_TYPE_ANY );
+        cyw43_arch_lwip_end();
+
         if ( udp_pcb == NULL ) 
         {
             printf("failed to create udp pcb\n");
@@ -217,56 +435,129 @@ static int ntp_get_time( void )
         }
         else
         {
-            int err;
+            ntp_race_state_t state;
+            int i;
+
             udp_recv( udp_pcb, ntp_receive, NULL );
 
             cyw43_arch_lwip_begin();
+            ntp_race_start( &race, time_us_64(), NTP_RACE_GOOD_DELAY_MS * 1000, NTP_RACE_GRACE_MS * 1000, NTP_RACE_TIMEOUT_MS * 1000 );
+            cyw43_arch_lwip_end();
+
+            // requests are sent from ntp_server_found() as addresses arrive
+            ntp_resolver_resolve( ntp_server_found );
 
-            err = dns_gethostbyname( NTP_SERVER_ADDR, &ntp_server_address, ntp_dns_found, NULL );
+            do
+            {
+                console_service();
+                sleep_ms(10);
+
+                cyw43_arch_lwip_begin();
+                state = ntp_race_poll( &race, time_us_64(), ntp_resolver_pending() > 0 );
+                cyw43_arch_lwip_end();
+            }
+            while ( state == NTP_RACE_RUNNING );
 
+            cyw43_arch_lwip_begin();
+            udp_remove( udp_pcb );
+            udp_pcb = NULL;
             cyw43_arch_lwip_end();
 
-            dns_request_sent = true;
-    
-            if (err == ERR_OK) 
-            {
-                ntp_request( );
-            } 
-            else if (err == ERR_INPROGRESS)
+            // look up servers which sent an invalid reply again next time, or
+            // every server if none replied; servers still to reply when a
+            // low delay reply ended the race keep their address
+            for ( i = 0; i < race.num_candidates; i++ )
             {
-                while ( dns_request_sent )
+                if ( ( state == NTP_RACE_FAILED ) || ( race.candidates[i].responded && !race.candidates[i].valid ) )
                 {
-                    sleep_ms(1000);
+                    ntp_resolver_invalidate( candidate_server[i] );
                 }
             }
-            else if (err != ERR_INPROGRESS) 
+
+            if ( state == NTP_RACE_DONE )
+            {
+                ntp_sync();
+            }
+            else
             {
-                printf("dns request failed\n");
-                dns_request_sent = false;
+                tlog( TLOG_FMT_NTP_FAILED, ntp_resolver_num_servers(), race.num_candidates);
                 retval = -1;
             }
         }
-        udp_remove( udp_pcb );
     }
     
+#if !METRICS_ENABLED
     cyw43_arch_disable_sta_mode();
+#endif
     
     return retval;
 }
 
 /******************************************************************
 *
-* main()
+* last_time_save()
 *
-* Main Program Body
+* save current time to watchdog scratch registers
 *
 *******************************************************************/
-int main() 
-{      
-    setup_default_uart();
+static void last_time_save( const datetime_t *t, bool dst )
+{
+    watchdog_hw->scratch[LAST_TIME_SCRATCH_DATE] = t->year << 16 | t->month << 8 | t->day;
+    watchdog_hw->scratch[LAST_TIME_SCRATCH_TIME] = dst << 24 | t->dotw << 16 | t->hour << 8 | t->min;
+    watchdog_hw->scratch[LAST_TIME_SCRATCH_MAGIC] = LAST_TIME_MAGIC;
+}
+
+/******************************************************************
+*
+* provisional_time_get()
+*
+* last known time from before a soft reset, else firmware build time
+*
+* returns true if BST
+*
+*******************************************************************/
+static bool provisional_time_get( datetime_t *t )
+{
+    bool dst = false;
+
+    if ( watchdog_hw->scratch[LAST_TIME_SCRATCH_MAGIC] == LAST_TIME_MAGIC )
+    {
+        uint32_t date = watchdog_hw->scratch[LAST_TIME_SCRATCH_DATE];
+        uint32_t hms = watchdog_hw->scratch[LAST_TIME_SCRATCH_TIME];
+
+        t->year = date >> 16;
+        t->month = ( date >> 8 ) & 0xFF;
+        t->day = date & 0xFF;
+        dst = ( hms >> 24 ) & 0x1;
+        t->dotw = ( hms >> 16 ) & 0xFF;
+        t->hour = ( hms >> 8 ) & 0xFF;
+        t->min = hms & 0xFF;
+        t->sec = 0;
+        printf("provisional time: last known\n");
+    }
+    else
+    {
+        dst = clock_build_datetime( t );
+        printf("provisional time: build time\n");
+    }
+    return dst;
+}
+
+/******************************************************************
+*
+* display_task()
+*
+* core 1: initialise LCD then display RTC time every second
+*
+* time is marked unsynced until NTP time has been received,
+* the display is refreshed as soon as NTP time arrives
+*
+*******************************************************************/
+static void display_task( void )
+{
+    bool synced = false;
+    bool boot_reported = false;
 
-    printf("\n\n\nNTP Clock: main()\n");
-    
     /* PICO-W I2C0 on the default SDA and SCL pins (4, 5) 400KHz I2C */
     i2c_init( PICO_DEFAULT_I2C_INSTANCE(), 400000 );
     gpio_set_function( PICO_DEFAULT_I2C_SDA_PIN, GPIO_FUNC_I2C );
@@ -275,48 +566,125 @@ int main()
     gpio_pull_up( PICO_DEFAULT_I2C_SCL_PIN );
 
     /* Initialize LCD */
+    boot_phase_mark( BOOT_PHASE_LCD_INIT_START );
     hd44780_lcd_init();
+    boot_phase_mark( BOOT_PHASE_LCD_INIT_DONE );
+
+    while (true) 
+    {           
+        datetime_t t;
+        char date_line[CLOCK_LINE_LEN];
+        char time_line[CLOCK_LINE_LEN];
+        uint32_t frame_start_us;
+        int i;
+
+        synced = ntp_synced;
+        
+        rtc_get_datetime( &t );
+        trace_rtc_read( &t );
+
+        clock_format_lines( &t, is_dst, synced, date_line, time_line );
+        
+        tlog( TLOG_FMT_DISPLAY, t.day, t.month, t.year, t.hour, t.min, t.sec, is_dst, synced);
 
-    /* Initialize RTC */
+        frame_start_us = time_us_32();
+        lcd_show_line( 0, date_line );
+        lcd_show_line( 1, time_line );
+        metrics_set_lcd_frame( time_us_32() - frame_start_us );
+
+        last_time_save( &t, is_dst );
+
+        boot_phase_mark( BOOT_PHASE_FIRST_DISPLAY );
+        if ( synced && !boot_reported )
+        {
+            boot_phase_mark( BOOT_PHASE_FIRST_VALID_DISPLAY );
+            boot_phase_report();
+            boot_reported = true;
+        }
+
+        /* wait 1 second, or until NTP time received */
+        for ( i = 0; ( i < 100 ) && ( synced == ntp_synced ); i++ )
+        {
+            sleep_ms(10);
+        }
+    }
+}
+
+/******************************************************************
+*
+* main()
+*
+* Main Program Body
+*
+*******************************************************************/
+int main() 
+{      
+    datetime_t t;
+    bool resync_enabled = false;
+    int retry_count = 0;
+#if METRICS_ENABLED
+    int rssi_count = 0;
+#endif
+
+    setup_default_uart();
+
+    printf("\n\n\nNTP Clock: main()\n");
+
+    trace_init();
+    metrics_init();
+    boot_phase_mark( BOOT_PHASE_START );
+
+    /* Initialize RTC with provisional time until NTP time received */
     rtc_init();
+    is_dst = provisional_time_get( &t );
+    rtc_set_datetime( &t );
+
+    /* LCD initialisation & display on core 1, overlaps Wi-Fi start up */
+    multicore_launch_core1( display_task );
 
     /* Initialize Wi-Fi */
+    boot_phase_mark( BOOT_PHASE_CYW43_INIT_START );
     if ( cyw43_arch_init() ) 
     {
         printf("cyw43_arch failed to initialise\n");
     }
     else
     {          
-        hd44780_lcd_clear();
-        hd44780_lcd_set_cursor(0, 0);
-        hd44780_lcd_string( "===NTP Clock===" ); 
-           
+        boot_phase_mark( BOOT_PHASE_CYW43_INIT_DONE );
         ntp_get_time();
+        resync_enabled = true;
+    }
                
-        while (true) 
-        {           
-            datetime_t t;
-            char datetime_buf[256];
-            
-            rtc_get_datetime( &t );
-            
-            sprintf( datetime_buf, "%s %02d %s %04d", dayofweek[t.dotw], t.day, months[t.month-1], t.year);
-            printf("\r%s  ", datetime_buf);
-            hd44780_lcd_set_cursor(0, 0);
-            hd44780_lcd_string( datetime_buf );
-
-            sprintf( datetime_buf, "%02d:%02d:%02d    %03s", t.hour, t.min, t.sec, is_dst ? timezone[1]:timezone[0] );
-            printf("   %s", datetime_buf);
-            hd44780_lcd_set_cursor(1, 0);
-            hd44780_lcd_string( datetime_buf );
-
-            /* update NTP time at 3am */
-            if ( ( t.day != current_day ) && ( t.hour == 3 ) )
+    while (true) 
+    {           
+        rtc_get_datetime( &t );
+
+        /* update NTP time at 3am */
+        if ( resync_enabled && ( t.day != current_day ) && ( t.hour == 3 ) )
+        {
+            ntp_get_time();
+            current_day = t.day;
+        }
+        else if ( resync_enabled && !ntp_synced && ( ++retry_count >= NTP_UNSYNCED_RETRY_S ) )
+        {
+            ntp_get_time();
+            retry_count = 0;
+        }
+
+#if METRICS_ENABLED
+        if ( resync_enabled && ( ++rssi_count >= RSSI_SAMPLE_S ) )
+        {
+            int32_t rssi;
+
+            if ( cyw43_wifi_get_rssi( &cyw43_state, &rssi ) == 0 )
             {
-                ntp_get_time();
-                current_day = t.day;
+                metrics_set_wifi_rssi( rssi );
             }
-            sleep_ms(1000);
+            rssi_count = 0;
         }
+#endif
+
+        console_service();
+        sleep_ms(1000);
     }
 }
@@ -0,0 +1,341 @@
+/*******************************************************************
+*
+* tlog.c
+*
+* Deferred tokenised logging
+*
+* Each core logs into its own single producer / single consumer
+* ring so no lock is shared between the cores. The producer only
+* writes head, the consumer (tlog_drain() on core 0) only writes
+* tail. On core 0 interrupts are disabled while a record is written
+* as the lwIP callbacks log from IRQ context.
+*
+* tlog_drain() sends the records of both rings in time order.
+*
+* Also builds on the host (no PICO_ON_DEVICE) for apps/tlog_bench,
+* frames are then written to tlog_host_output
+*
+********************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#include "pico/platform.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#else
+#include <time.h>
+#endif
+
+#include "tlog.h"
+#include "tlog_fmt.h"
+
+#if TLOG_ENABLED
+
+#if PICO_ON_DEVICE
+#define tlog_putc( c ) putchar_raw( c )
+#else
+// host build: single core, no interrupts
+FILE *tlog_host_output = NULL;
+
+#define tlog_putc( c ) ( tlog_host_output ? fputc( c, tlog_host_output ) : 0 )
+#define get_core_num() 0
+#define save_and_disable_interrupts() 0
+#define restore_interrupts( status ) (void)( status )
+#define __dmb() __sync_synchronize()
+
+static uint32_t time_us_32( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint32_t)( ts.tv_sec * 1000000ull + ts.tv_nsec / 1000 );
+}
+#endif
+
+#define TLOG_RING_MASK  (TLOG_RING_WORDS - 1)
+#define TLOG_NUM_CORES  2
+
+typedef struct
+{
+    uint32_t buf[TLOG_RING_WORDS];
+    volatile uint32_t head;         // free running, written by producer
+    volatile uint32_t tail;         // free running, written by tlog_drain()
+    volatile uint32_t dropped;      // written by producer
+    uint32_t dropped_sent;          // written by tlog_drain()
+} tlog_ring_t;
+
+static tlog_ring_t rings[TLOG_NUM_CORES];
+
+/******************************************************************
+*
+* tlog_write()
+*
+* append record to the calling core's ring, dropped if full
+*
+*******************************************************************/
+void tlog_write( uint32_t id, uint32_t nargs, const uint32_t *args )
+{
+    tlog_ring_t *r = &rings[get_core_num()];
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t head = r->head;
+
+    if ( ( TLOG_RING_WORDS - ( head - r->tail ) ) < ( TLOG_RECORD_WORDS + nargs ) )
+    {
+        r->dropped++;
+    }
+    else
+    {
+        r->buf[head++ & TLOG_RING_MASK] = id;
+        r->buf[head++ & TLOG_RING_MASK] = time_us_32();
+        r->buf[head++ & TLOG_RING_MASK] = nargs;
+        while ( nargs-- )
+        {
+            r->buf[head++ & TLOG_RING_MASK] = *args++;
+        }
+        // record written before it is published to tlog_drain()
+        __dmb();
+        r->head = head;
+    }
+
+    restore_interrupts( irq );
+}
+
+/******************************************************************
+*
+* put_varint()
+*
+*******************************************************************/
+static uint8_t *put_varint( uint8_t *p, uint32_t value )
+{
+    while ( value >= 0x80 )
+    {
+        *p++ = value | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+/******************************************************************
+*
+* send_frame()
+*
+* COBS encode payload between 0x00 delimiters, returns bytes sent
+*
+*******************************************************************/
+static uint32_t send_frame( const uint8_t *payload, uint32_t len )
+{
+    uint8_t frame[TLOG_PAYLOAD_MAX + 3];
+    uint32_t code_pos = 1;
+    uint32_t n = 2;
+    uint32_t i;
+
+    frame[0] = 0x00;
+    for ( i = 0; i < len; i++ )
+    {
+        if ( payload[i] == 0x00 )
+        {
+            frame[code_pos] = n - code_pos;
+            code_pos = n++;
+        }
+        else
+        {
+            frame[n++] = payload[i];
+        }
+    }
+    frame[code_pos] = n - code_pos;
+    frame[n++] = 0x00;
+
+    for ( i = 0; i < n; i++ )
+    {
+        tlog_putc( frame[i] );
+    }
+    return n;
+}
+
+/******************************************************************
+*
+* send_record()
+*
+* encode record words as a frame payload and send it
+*
+*******************************************************************/
+static uint32_t send_record( uint8_t flags, uint32_t time_us, uint32_t id, uint32_t nargs, const uint32_t *args )
+{
+    uint8_t payload[TLOG_PAYLOAD_MAX];
+    uint8_t *p = payload;
+    uint8_t sum = 0;
+    uint32_t i;
+
+    *p++ = flags | ( nargs & TLOG_NARGS_MASK );
+    *p++ = time_us;
+    *p++ = time_us >> 8;
+    *p++ = time_us >> 16;
+    *p++ = time_us >> 24;
+    p = put_varint( p, id );
+    for ( i = 0; i < nargs; i++ )
+    {
+        p = put_varint( p, args[i] );
+    }
+    for ( i = 0; i < (uint32_t)( p - payload ); i++ )
+    {
+        sum += payload[i];
+    }
+    *p++ = sum;
+
+    return send_frame( payload, p - payload );
+}
+
+/******************************************************************
+*
+* tlog_drain()
+*
+* send all records in both rings, oldest first
+*
+* must only be called from one context (core 0 main loop),
+* returns bytes sent
+*
+*******************************************************************/
+uint32_t tlog_drain( void )
+{
+    uint32_t bytes = 0;
+    int core;
+
+    for ( core = 0; core < TLOG_NUM_CORES; core++ )
+    {
+        tlog_ring_t *r = &rings[core];
+        uint32_t dropped = r->dropped;
+
+        if ( dropped != r->dropped_sent )
+        {
+            uint32_t count = dropped - r->dropped_sent;
+
+            bytes += send_record( TLOG_FLAG_DROPPED | ( core ? TLOG_FLAG_CORE1 : 0 ), time_us_32(), 0, 1, &count );
+            r->dropped_sent = dropped;
+        }
+    }
+
+    while ( true )
+    {
+        uint32_t args[TLOG_MAX_ARGS];
+        tlog_ring_t *r = NULL;
+        uint32_t tail, id, time_us, nargs, i;
+        uint32_t oldest_us = 0;
+
+        // pick the ring whose next record is oldest
+        for ( core = 0; core < TLOG_NUM_CORES; core++ )
+        {
+            tlog_ring_t *c = &rings[core];
+
+            if ( c->head != c->tail )
+            {
+                // head read before the record it publishes
+                __dmb();
+                time_us = c->buf[( c->tail + 1 ) & TLOG_RING_MASK];
+                if ( ( r == NULL ) || ( (int32_t)( time_us - oldest_us ) < 0 ) )
+                {
+                    r = c;
+                    oldest_us = time_us;
+                }
+            }
+        }
+        if ( r == NULL )
+            break;
+
+        tail = r->tail;
+        id = r->buf[tail++ & TLOG_RING_MASK];
+        time_us = r->buf[tail++ & TLOG_RING_MASK];
+        nargs = r->buf[tail++ & TLOG_RING_MASK];
+        for ( i = 0; i < nargs; i++ )
+        {
+            args[i] = r->buf[tail++ & TLOG_RING_MASK];
+        }
+
+        // record copied before its space is released to the producer
+        __dmb();
+        r->tail = tail;
+
+        bytes += send_record( r == &rings[1] ? TLOG_FLAG_CORE1 : 0, time_us, id, nargs, args );
+    }
+
+    return bytes;
+}
+
+#if PICO_ON_DEVICE
+
+#define TLOG_BENCH_CALLS 32
+
+/******************************************************************
+*
+* systick_cycles()
+*
+* cycles between SysTick readings, counts down from 0xFFFFFF
+*
+*******************************************************************/
+static inline uint32_t systick_cycles( uint32_t start, uint32_t end )
+{
+    return ( start - end ) & 0xFFFFFF;
+}
+
+/******************************************************************
+*
+* tlog_benchmark()
+*
+* print cycles per call of tlog() vs snprintf() and printf() for
+* the display loop log line, run from the core 0 main loop
+*
+*******************************************************************/
+void tlog_benchmark( void )
+{
+    char line[64];
+    uint32_t tlog_cycles, snprintf_cycles, printf_cycles;
+    uint32_t start, irq;
+    int i;
+
+    // flush pending records so the benchmark records fit in the ring
+    tlog_drain();
+
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;      // enabled, processor clock
+
+    irq = save_and_disable_interrupts();
+    start = systick_hw->cvr;
+    for ( i = 0; i < TLOG_BENCH_CALLS; i++ )
+    {
+        tlog( TLOG_FMT_DISPLAY, 19, 10, 2026, 12, 34, i, 1, 1 );
+    }
+    tlog_cycles = systick_cycles( start, systick_hw->cvr );
+
+    start = systick_hw->cvr;
+    for ( i = 0; i < TLOG_BENCH_CALLS; i++ )
+    {
+        snprintf( line, sizeof(line), TLOG_FMT_DISPLAY, 19, 10, 2026, 12, 34, i, 1, 1 );
+    }
+    snprintf_cycles = systick_cycles( start, systick_hw->cvr );
+    restore_interrupts( irq );
+
+    // printf blocks on the UART, timed with interrupts enabled
+    start = time_us_32();
+    for ( i = 0; i < TLOG_BENCH_CALLS; i++ )
+    {
+        printf( TLOG_FMT_DISPLAY "\n", 19, 10, 2026, 12, 34, i, 1, 1 );
+    }
+    printf_cycles = ( time_us_32() - start ) * ( clock_get_hz( clk_sys ) / 1000000 );
+
+    systick_hw->csr = 0;
+
+    printf("tlog benchmark, %d calls, cycles per call:\n", TLOG_BENCH_CALLS);
+    printf("  tlog     %8u\n", (unsigned int)( tlog_cycles / TLOG_BENCH_CALLS ));
+    printf("  snprintf %8u\n", (unsigned int)( snprintf_cycles / TLOG_BENCH_CALLS ));
+    printf("  printf   %8u\n", (unsigned int)( printf_cycles / TLOG_BENCH_CALLS ));
+    printf("  drain    %8u bytes\n", (unsigned int)tlog_drain());
+}
+
+#endif // PICO_ON_DEVICE
+
+#endif // TLOG_ENABLED
@@ -0,0 +1,90 @@
+/*******************************************************************
+*
+* tlog.h
+*
+* Deferred tokenised logging
+*
+* tlog( "fmt", args... ) records the address of the format string
+* and up to TLOG_MAX_ARGS integer arguments (converted to uint32_t)
+* in a per-core RAM ring. Nothing is formatted on the clock,
+* tlog_drain() sends the records over the UART console as binary
+* frames, mixed with normal printf() text, and apps/tlog_decode
+* rebuilds the text using the format strings read from the ELF.
+*
+* Format strings are placed in section .tlog_fmt which tlog.ld
+* links at address 0 outside flash, so the strings cost no flash
+* and the record id is the string offset in the section.
+*
+* Only integer conversions (%d %i %u %x %X %o %c with flags, width
+* and precision) are supported, %s is not.
+*
+* Frame format:
+*   0x00, COBS encoded payload, 0x00
+*
+* Payload:
+*   uint8_t  flags        TLOG_FLAG_CORE1 | TLOG_FLAG_DROPPED | nargs
+*   uint32_t time_us      time_us_32() when logged (little endian)
+*   varint   id           format string address
+*   varint   args[nargs]
+*   uint8_t  checksum     sum of the preceding payload bytes
+*
+* varint = unsigned LEB128, 7 bits per byte, low bits first.
+* A TLOG_FLAG_DROPPED frame has id 0 and one argument, the number
+* of records dropped because the ring was full.
+*
+* With TLOG_ENABLED 0 tlog() is printf() with a newline appended
+* and tlog_drain() does nothing. Arguments are passed to printf()
+* as they are, and int32_t is long on arm-none-eabi, so cast them
+* to int or unsigned int to match %d or %u.
+*
+********************************************************************/
+#ifndef __TLOG_H__
+#define __TLOG_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef TLOG_ENABLED
+#define TLOG_ENABLED 1
+#endif
+
+// per core RAM ring size in 32 bit words, must be a power of 2
+#ifndef TLOG_RING_WORDS
+#define TLOG_RING_WORDS 512
+#endif
+
+#define TLOG_MAX_ARGS      8
+#define TLOG_RECORD_WORDS  3         // id, time_us, nargs
+
+#define TLOG_FLAG_CORE1    0x80
+#define TLOG_FLAG_DROPPED  0x40
+#define TLOG_NARGS_MASK    0x0F
+
+// flags + time + id + args + checksum
+#define TLOG_PAYLOAD_MAX   ( 1 + 4 + 5 + TLOG_MAX_ARGS * 5 + 1 )
+
+#define TLOG_FMT_SECTION   ".tlog_fmt"
+
+// number of arguments, 0..TLOG_MAX_ARGS
+#define TLOG_NARGS( ... ) TLOG_NARGS_( 0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0 )
+#define TLOG_NARGS_( _0, _1, _2, _3, _4, _5, _6, _7, _8, n, ... ) n
+
+#if TLOG_ENABLED
+#define tlog( fmt, ... )                                                                        \
+    do                                                                                          \
+    {                                                                                           \
+        static const char tlog_fmt[] __attribute__((section(TLOG_FMT_SECTION), used)) = fmt;   \
+        tlog_write( (uint32_t)(uintptr_t)tlog_fmt, TLOG_NARGS( __VA_ARGS__ ),                    \
+                    (const uint32_t[TLOG_MAX_ARGS]){ __VA_ARGS__ } );                           \
+    } while ( 0 )
+
+void tlog_write( uint32_t id, uint32_t nargs, const uint32_t *args );
+uint32_t tlog_drain( void );
+void tlog_benchmark( void );
+#else
+#define tlog( fmt, ... ) printf( fmt "\n", ##__VA_ARGS__ )
+#define tlog_drain()
+#define tlog_benchmark()
+#endif
+
+#endif // __TLOG_H__
@@ -0,0 +1,42 @@
+/*******************************************************************
+*
+* tlog_fmt.h
+*
+* Format strings of the clock's tlog() log lines
+*
+* Shared with apps/tlog_bench so the benchmarked lines and the
+* flash saved figure follow the clock's own log lines
+*
+* Arguments are cast to int or unsigned int at the call site to
+* match the printf() fallback, see tlog.h
+*
+********************************************************************/
+#ifndef __TLOG_FMT_H__
+#define __TLOG_FMT_H__
+
+// display loop, day, month, year, hour, min, sec, dst, synced
+#define TLOG_FMT_DISPLAY            "%02d/%02d/%04d %02d:%02d:%02d dst %d synced %d"
+
+// DNS
+#define TLOG_FMT_DNS_FAILED         "ntp dns request failed: server %d"
+#define TLOG_FMT_DNS_FOUND          "found ntp address %u.%u.%u.%u server %d"
+#define TLOG_FMT_DNS_FOUND_IPV6     "found ntp IPv6 address server %d"
+
+// NTP responses, result is ntp_response_result_t
+#define TLOG_FMT_NTP_UNKNOWN_SOURCE "ntp response from unknown source"
+#define TLOG_FMT_NTP_LATE           "ntp response: server %d after race over"
+#define TLOG_FMT_NTP_OK             "ntp response: server %d ok"
+#define TLOG_FMT_NTP_REJECTED       "ntp response rejected: server %d result %d"
+
+// NTP sync, year, month, day, hour, min, sec, offset ms, delay us
+#define TLOG_FMT_NTP_SYNC           "NTP RX: %04d-%02d-%02d %02d:%02d:%02d offset %d ms delay %d us"
+#define TLOG_FMT_NTP_SELECTED       "ntp server %d selected from %d candidates"
+#define TLOG_FMT_NTP_FAILED         "ntp request failed: %d servers, %d candidates"
+
+// every format string above, in .tlog_fmt rather than flash with TLOG_ENABLED
+#define TLOG_FMT_ALL                                                                    \
+    TLOG_FMT_DISPLAY, TLOG_FMT_DNS_FAILED, TLOG_FMT_DNS_FOUND, TLOG_FMT_DNS_FOUND_IPV6, \
+    TLOG_FMT_NTP_UNKNOWN_SOURCE, TLOG_FMT_NTP_LATE, TLOG_FMT_NTP_OK,                    \
+    TLOG_FMT_NTP_REJECTED, TLOG_FMT_NTP_SYNC, TLOG_FMT_NTP_SELECTED, TLOG_FMT_NTP_FAILED
+
+#endif // __TLOG_FMT_H__
@@ -0,0 +1,137 @@
+/*******************************************************************
+*
+* trace.c
+*
+* Compact binary event trace kept in a RAM ring buffer
+*
+* Oldest records are discarded when the ring is full. Recording is
+* safe from both cores and from the lwIP callback (IRQ) context.
+* Events recorded while a dump is in progress are dropped so the
+* dump does not hold the lock for the duration of the UART output.
+*
+********************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+
+#include "trace.h"
+
+#if TRACE_ENABLED
+
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+static uint8_t ring[TRACE_RING_SIZE];
+static uint32_t head = 0;               // free running write index
+static uint32_t tail = 0;               // free running index of oldest record
+static uint32_t dropped = 0;
+static volatile bool dumping = false;
+
+static critical_section_t trace_lock;
+
+/******************************************************************
+*
+* ring_put()
+*
+*******************************************************************/
+static void ring_put( const uint8_t *data, uint32_t len )
+{
+    while ( len-- )
+    {
+        ring[head++ & TRACE_RING_MASK] = *data++;
+    }
+}
+
+/******************************************************************
+*
+* trace_init()
+*
+*******************************************************************/
+void trace_init( void )
+{
+    critical_section_init( &trace_lock );
+    head = 0;
+    tail = 0;
+    dropped = 0;
+}
+
+/******************************************************************
+*
+* trace_record()
+*
+* append event record to ring, discarding oldest records if full
+*
+*******************************************************************/
+void trace_record( trace_event_t type, const void *data, uint8_t len )
+{
+    uint8_t header[TRACE_HEADER_LEN];
+    uint32_t now;
+
+    critical_section_enter_blocking( &trace_lock );
+
+    // timestamp under the lock so records from both cores are in time order
+    now = time_us_32();
+    header[0] = type;
+    header[1] = len;
+    header[2] = now;
+    header[3] = now >> 8;
+    header[4] = now >> 16;
+    header[5] = now >> 24;
+
+    if ( dumping )
+    {
+        dropped++;
+    }
+    else
+    {
+        while ( ( TRACE_RING_SIZE - ( head - tail ) ) < ( TRACE_HEADER_LEN + len ) )
+        {
+            tail += TRACE_HEADER_LEN + ring[( tail + 1 ) & TRACE_RING_MASK];
+        }
+        ring_put( header, TRACE_HEADER_LEN );
+        ring_put( (const uint8_t *)data, len );
+    }
+
+    critical_section_exit( &trace_lock );
+}
+
+/******************************************************************
+*
+* trace_dump()
+*
+* hex dump all records in ring to stdout (UART)
+*
+*******************************************************************/
+void trace_dump( void )
+{
+    uint32_t start, end, i;
+
+    critical_section_enter_blocking( &trace_lock );
+    dumping = true;
+    start = tail;
+    end = head;
+    critical_section_exit( &trace_lock );
+
+    printf("\nTRACE BEGIN %u\n", (unsigned int)( end - start ));
+    for ( i = start; i != end; i++ )
+    {
+        printf("%02x", ring[i & TRACE_RING_MASK]);
+        if ( ( ( i - start ) % TRACE_DUMP_LINE_BYTES ) == ( TRACE_DUMP_LINE_BYTES - 1 ) )
+            printf("\n");
+    }
+    if ( ( end - start ) % TRACE_DUMP_LINE_BYTES )
+        printf("\n");
+    printf("TRACE END\n");
+
+    critical_section_enter_blocking( &trace_lock );
+    dumping = false;
+    i = dropped;
+    dropped = 0;
+    critical_section_exit( &trace_lock );
+
+    if ( i )
+        printf("trace: %u events dropped during dump\n", (unsigned int)i);
+}
+
+#endif // TRACE_ENABLED
@@ -0,0 +1,97 @@
+/*******************************************************************
+*
+* trace.h
+*
+* Compact binary event trace kept in a RAM ring buffer and dumped
+* over UART for offline replay on the host (apps/trace_replay.c)
+*
+* Record format (little endian):
+*   uint8_t  type
+*   uint8_t  len          payload length
+*   uint32_t time_us      time_us_32() when recorded
+*   uint8_t  payload[len]
+*
+* Dump format:
+*   TRACE BEGIN <bytes>
+*   <hex encoded records, TRACE_DUMP_LINE_BYTES per line>
+*   TRACE END
+*
+********************************************************************/
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+// RAM ring buffer size, must be a power of 2
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 16384
+#endif
+
+#define TRACE_HEADER_LEN       6
+#define TRACE_DUMP_LINE_BYTES  32
+
+typedef enum
+{
+    TRACE_EVENT_RTC_READ = 1,   // trace_datetime_t
+    TRACE_EVENT_NTP_TX,         // trace_ntp_tx_t header + raw NTP request
+    TRACE_EVENT_NTP_RX,         // trace_ntp_rx_t header + raw NTP response
+    TRACE_EVENT_DNS_SENT,       // int8_t dns_gethostbyname() result
+    TRACE_EVENT_DNS_RESULT,     // uint32_t IPv4 address, 0 = failed or IPv6
+    TRACE_EVENT_WIFI_STATUS,    // int8_t connect result, int8_t link status
+    TRACE_EVENT_LCD_FRAME,      // uint8_t row + line text
+    TRACE_EVENT_BOOT_PHASE,     // uint8_t boot_phase_t
+    TRACE_EVENT_NTP_SYNC,       // trace_ntp_sync_t, race winner the RTC is set from
+    TRACE_EVENT_NUM_TYPES
+} trace_event_t;
+
+typedef struct __attribute__((packed))
+{
+    int16_t year;
+    int8_t month;
+    int8_t day;
+    int8_t dotw;
+    int8_t hour;
+    int8_t min;
+    int8_t sec;
+} trace_datetime_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t addr;          // IPv4 destination address (network byte order), 0 = IPv6
+    int8_t server;          // NTP_SERVER_LIST index
+    uint8_t candidate;      // ntp_race_add() index, 0 = first request of a race
+} trace_ntp_tx_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t addr;          // IPv4 source address (network byte order)
+    uint16_t port;
+    uint16_t tot_len;       // received length, payload holds up to NTP_MESSAGE_LEN bytes
+} trace_ntp_rx_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t transmit_seconds;  // selected reply transmit timestamp
+    uint32_t transmit_fraction;
+    uint32_t delay_us;          // round trip delay
+    uint16_t correction_ms;     // fraction + half round trip + time since receipt,
+                                // RTC set to transmit_seconds + correction rounded
+    int8_t server;              // NTP_SERVER_LIST index
+    uint8_t candidates;         // candidates in the race
+} trace_ntp_sync_t;
+
+#if TRACE_ENABLED
+void trace_init( void );
+void trace_record( trace_event_t type, const void *data, uint8_t len );
+void trace_dump( void );
+#else
+#define trace_init()
+#define trace_record( type, data, len )
+#define trace_dump()
+#endif
+
+#endif // __TRACE_H__